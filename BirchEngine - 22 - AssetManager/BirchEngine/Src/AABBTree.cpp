@@ -0,0 +1,236 @@
+#include "AABBTree.h"
+#include <algorithm>
+
+AABBTree::AABBTree(int mMargin) : margin(mMargin)
+{}
+
+int AABBTree::insert(const SDL_Rect& mBox, EntityHandle mEntity)
+{
+	int leaf = allocateNode();
+	Node& n(nodes[leaf]);
+	n.box = mBox;
+	n.entity = mEntity;
+	n.fat = boundsOf(mBox);
+	n.fat.left -= margin;
+	n.fat.top -= margin;
+	n.fat.right += margin;
+	n.fat.bottom += margin;
+	n.height = 0;
+
+	insertLeaf(leaf);
+	return leaf;
+}
+
+bool AABBTree::move(int mProxy, const SDL_Rect& mBox)
+{
+	nodes[mProxy].box = mBox;
+	Bounds b(boundsOf(mBox));
+	if (contains(nodes[mProxy].fat, b)) return false;
+
+	removeLeaf(mProxy);
+	nodes[mProxy].fat = Bounds{ b.left - margin, b.top - margin, b.right + margin, b.bottom + margin };
+	insertLeaf(mProxy);
+	return true;
+}
+
+void AABBTree::remove(int mProxy)
+{
+	removeLeaf(mProxy);
+	freeNodeAt(mProxy);
+}
+
+int AABBTree::allocateNode()
+{
+	int i;
+	if (freeNode != nullNode)
+	{
+		i = freeNode;
+		freeNode = nodes[i].parent;
+	}
+	else
+	{
+		i = static_cast<int>(nodes.size());
+		nodes.emplace_back();
+	}
+
+	Node& n(nodes[i]);
+	n.parent = nullNode;
+	n.child1 = nullNode;
+	n.child2 = nullNode;
+	n.height = 0;
+	return i;
+}
+
+void AABBTree::freeNodeAt(int mNode)
+{
+	nodes[mNode].parent = freeNode;
+	nodes[mNode].height = -1;
+	freeNode = mNode;
+}
+
+void AABBTree::insertLeaf(int mLeaf)
+{
+	if (root == nullNode)
+	{
+		root = mLeaf;
+		nodes[root].parent = nullNode;
+		return;
+	}
+
+	/*
+	Walk down to the best sibling for the leaf: at each node, stop if pairing
+	the leaf with this node is cheaper than going down either side. A child's
+	cost is how much its box would grow, plus what that growth costs every
+	node above it (the inheritance).
+	*/
+	Bounds leafFat(nodes[mLeaf].fat);
+	int index = root;
+	while (!nodes[index].isLeaf())
+	{
+		const Node& n(nodes[index]);
+		long combined = perimeter(combine(n.fat, leafFat));
+		long cost = 2 * combined;
+		long inheritance = 2 * (combined - perimeter(n.fat));
+
+		long childCost[2];
+		int children[2] = { n.child1, n.child2 };
+		for (int c = 0; c < 2; c++)
+		{
+			const Node& child(nodes[children[c]]);
+			long grown = perimeter(combine(child.fat, leafFat));
+			childCost[c] = (child.isLeaf() ? grown : grown - perimeter(child.fat)) + inheritance;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1]) break;
+		index = (childCost[0] < childCost[1]) ? children[0] : children[1];
+	}
+	int sibling = index;
+
+	// a new parent for the sibling and the leaf, where the sibling was
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocateNode();
+	Node& p(nodes[newParent]);
+	p.parent = oldParent;
+	p.fat = combine(leafFat, nodes[sibling].fat);
+	p.height = nodes[sibling].height + 1;
+	p.child1 = sibling;
+	p.child2 = mLeaf;
+	nodes[sibling].parent = newParent;
+	nodes[mLeaf].parent = newParent;
+
+	if (oldParent == nullNode)
+	{
+		root = newParent;
+	}
+	else
+	{
+		if (nodes[oldParent].child1 == sibling) nodes[oldParent].child1 = newParent;
+		else nodes[oldParent].child2 = newParent;
+	}
+
+	fixUpwards(oldParent);
+}
+
+void AABBTree::removeLeaf(int mLeaf)
+{
+	if (mLeaf == root)
+	{
+		root = nullNode;
+		return;
+	}
+
+	// the leaf's parent goes too, and the sibling takes its place
+	int parent = nodes[mLeaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = (nodes[parent].child1 == mLeaf) ? nodes[parent].child2 : nodes[parent].child1;
+
+	nodes[sibling].parent = grandParent;
+	if (grandParent == nullNode)
+	{
+		root = sibling;
+	}
+	else
+	{
+		if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+		else nodes[grandParent].child2 = sibling;
+	}
+	freeNodeAt(parent);
+
+	fixUpwards(grandParent);
+}
+
+void AABBTree::fixUpwards(int mNode)
+{
+	while (mNode != nullNode)
+	{
+		mNode = balance(mNode);
+
+		Node& n(nodes[mNode]);
+		n.height = 1 + std::max(nodes[n.child1].height, nodes[n.child2].height);
+		n.fat = combine(nodes[n.child1].fat, nodes[n.child2].fat);
+
+		mNode = n.parent;
+	}
+}
+
+/*
+If one child of a is more than one level taller than the other, the taller
+child takes a's place and a takes the taller grandchild's shorter sibling:
+a rotation, as in an AVL tree. Returns whichever node is now where a was.
+*/
+int AABBTree::balance(int iA)
+{
+	Node& a(nodes[iA]);
+	if (a.isLeaf() || a.height < 2) return iA;
+
+	int iB = a.child1;
+	int iC = a.child2;
+	int diff = nodes[iC].height - nodes[iB].height;
+	if (diff >= -1 && diff <= 1) return iA;
+
+	// the taller child comes up; "up" is it, "stays" is a's other child
+	bool rightHeavy = diff > 1;
+	int iUp = rightHeavy ? iC : iB;
+	int iStays = rightHeavy ? iB : iC;
+	Node& up(nodes[iUp]);
+
+	int iF = up.child1;
+	int iG = up.child2;
+
+	// up takes a's place under a's parent, and a becomes up's child
+	up.child1 = iA;
+	up.parent = a.parent;
+	a.parent = iUp;
+	if (up.parent == nullNode)
+	{
+		root = iUp;
+	}
+	else
+	{
+		if (nodes[up.parent].child1 == iA) nodes[up.parent].child1 = iUp;
+		else nodes[up.parent].child2 = iUp;
+	}
+
+	// up keeps its taller child; the shorter one goes to a, in up's old slot
+	int iKeep = (nodes[iF].height > nodes[iG].height) ? iF : iG;
+	int iGive = (iKeep == iF) ? iG : iF;
+	up.child2 = iKeep;
+	if (rightHeavy) a.child2 = iGive;
+	else a.child1 = iGive;
+	nodes[iGive].parent = iA;
+
+	a.fat = combine(nodes[iStays].fat, nodes[iGive].fat);
+	a.height = 1 + std::max(nodes[iStays].height, nodes[iGive].height);
+	up.fat = combine(a.fat, nodes[iKeep].fat);
+	up.height = 1 + std::max(a.height, nodes[iKeep].height);
+
+	return iUp;
+}
+
+AABBTree::Bounds AABBTree::combine(const Bounds& b1, const Bounds& b2)
+{
+	return Bounds{
+		std::min(b1.left, b2.left), std::min(b1.top, b2.top),
+		std::max(b1.right, b2.right), std::max(b1.bottom, b2.bottom)
+	};
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <SDL.h>
+#include <vector>
+#include "ECS\ECS.h"
+
+/*
+A dynamic bounding volume tree: every box is a leaf, and every other node
+holds the box around its two children, so "what overlaps this rectangle?"
+only walks down the branches whose boxes overlap it, in about log n steps
+however the boxes are sized. That suits this game, where a 6x6 bullet and a
+spider scaled up to 36x36 have to share one structure, which a grid with a
+single cell size can't do well.
+
+Leaves are kept a margin larger than their box ("fat"), so a box that moves
+a little is still inside its leaf and move() only has to note where it is;
+only when it leaves the fat box is the leaf taken out and put back in. The
+tree is kept balanced with rotations as leaves come and go.
+
+insert() hands back a proxy, the leaf's index, to move() and remove() it by.
+Each leaf holds a copy of its box along with its entity's handle.
+*/
+class AABBTree
+{
+public:
+	static const int nullNode = -1;
+
+	explicit AABBTree(int mMargin);
+
+	int insert(const SDL_Rect& mBox, EntityHandle mEntity);
+	// true if the box left its fat box and the leaf had to be put back in
+	bool move(int mProxy, const SDL_Rect& mBox);
+	void remove(int mProxy);
+
+	EntityHandle entity(int mProxy) const { return nodes[mProxy].entity; }
+	const SDL_Rect& box(int mProxy) const { return nodes[mProxy].box; }
+
+	// calls f(EntityHandle, const SDL_Rect& box) for every box overlapping (or touching) mArea
+	template <typename F>
+	void query(const SDL_Rect& mArea, F f) const
+	{
+		if (root != nullNode) queryNode(root, boundsOf(mArea), f);
+	}
+
+	// the longest path from the root to a leaf; about log2 of the leaves when balanced
+	int height() const { return root == nullNode ? 0 : nodes[root].height; }
+
+private:
+	// edges rather than x/y/w/h, inclusive on both ends like Collision::AABB()
+	struct Bounds
+	{
+		int left, top, right, bottom;
+	};
+
+	struct Node
+	{
+		Bounds fat;
+		// leaves only: the box as given, and whose it is
+		SDL_Rect box;
+		EntityHandle entity;
+
+		int parent; // the next free node, while free
+		int child1;
+		int child2;
+		// 0 for a leaf, -1 while free
+		int height;
+
+		bool isLeaf() const { return child1 == nullNode; }
+	};
+
+	int margin;
+	int root = nullNode;
+	std::vector<Node> nodes;
+	int freeNode = nullNode;
+
+	int allocateNode();
+	void freeNodeAt(int mNode);
+	void insertLeaf(int mLeaf);
+	void removeLeaf(int mLeaf);
+	// refits and rebalances every node from mNode up to the root
+	void fixUpwards(int mNode);
+	int balance(int mNode);
+
+	template <typename F>
+	void queryNode(int mNode, const Bounds& mArea, F& f) const
+	{
+		const Node& n(nodes[mNode]);
+		if (!overlaps(n.fat, mArea)) return;
+
+		if (n.isLeaf())
+		{
+			// the fat box overlapping isn't enough; the real one has to
+			if (overlaps(boundsOf(n.box), mArea)) f(n.entity, n.box);
+			return;
+		}
+		queryNode(n.child1, mArea, f);
+		queryNode(n.child2, mArea, f);
+	}
+
+	static Bounds boundsOf(const SDL_Rect& mBox)
+	{
+		return Bounds{ mBox.x, mBox.y, mBox.x + mBox.w, mBox.y + mBox.h };
+	}
+	static bool overlaps(const Bounds& b1, const Bounds& b2)
+	{
+		return b1.right >= b2.left && b2.right >= b1.left && b1.bottom >= b2.top && b2.bottom >= b1.top;
+	}
+	static bool contains(const Bounds& mOuter, const Bounds& mInner)
+	{
+		return mOuter.left <= mInner.left && mOuter.top <= mInner.top &&
+			mInner.right <= mOuter.right && mInner.bottom <= mOuter.bottom;
+	}
+	static Bounds combine(const Bounds& b1, const Bounds& b2);
+	// what the insertion heuristic minimises; in 2D the perimeter plays the part of surface area
+	static long perimeter(const Bounds& b)
+	{
+		return 2L * ((b.right - b.left) + (b.bottom - b.top));
+	}
+};
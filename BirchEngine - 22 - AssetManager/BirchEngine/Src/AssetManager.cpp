@@ -1,5 +1,6 @@
 #include "AssetManager.h"
 #include "ECS\Components.h"
+#include <cstdlib>
 
 AssetManager::AssetManager(Manager * man) : manager(man)
 {
@@ -7,32 +8,67 @@ AssetManager::AssetManager(Manager * man) : manager(man)
 
 AssetManager::~AssetManager()
 {
+	// the one owner of these; tiles, sprites and projectiles only borrow them
+	for (auto& t : textures) SDL_DestroyTexture(t.second);
 }
 
-void AssetManager::CreateProjectile(Vector2D pos, Vector2D vel, int rng, int sp, std::string texID)
+void AssetManager::CreatePrefabs()
 {
-	auto& projectile(manager->addEntity());
-	projectile.addComponent<TransformComponent>(pos.x, pos.y, TILE_SIZE, TILE_SIZE, 1);
-	projectile.addComponent<SpriteComponent>(texID, false);
-	projectile.getComponent<SpriteComponent>().animIndex = 0;
-	projectile.addComponent<ProjectileComponent>(rng, sp, vel);
-	projectile.addComponent<ColliderComponent>("projectile", 13, 13, 6, 6);
-	projectile.addGroup(Game::groupProjectiles);
+	projectilePrefab.addComponent<TransformComponent>(0, 0, TILE_SIZE, TILE_SIZE, 1);
+	projectilePrefab.addComponent<SpriteComponent>("projectile", false).animIndex = 0;
+	projectilePrefab.addComponent<ProjectileComponent>(0, 0, Vector2D());
+	projectilePrefab.addComponent<ColliderComponent>(ProjectileLayer, 13, 13, 6, 6);
+
+	auto& transform(spiderPrefab.addComponent<TransformComponent>(0, 0, 64, 64, 1));
+	transform.speed = 2.5;
+	transform.speedLo = 1.0;
+	transform.speedHi = 3.5;
+	auto& sprite(spiderPrefab.addComponent<SpriteComponent>("monster", true));
+	sprite.animIndex = 0;
+	sprite.Play("MonsterWalk");
+	spiderPrefab.addComponent<ColliderComponent>(MonsterLayer, 20, 20, 24, 24);
+	spiderPrefab.addTag<MonsterTag>();
+}
 
+// Projectiles are fired from inside Manager::update(), so they are recorded in
+// the command buffer and only come into existence at the next refresh().
+void AssetManager::CreateProjectile(Vector2D pos, Vector2D vel, int rng, int sp, std::string texID)
+{
+	manager->getCommands().instantiate(projectilePrefab, [pos, vel, rng, sp, texID](Entity& e)
+	{
+		e.getComponent<TransformComponent>().position = pos;
+		if (texID != "projectile") e.getComponent<SpriteComponent>().setTexture(texID);
+		e.getComponent<ProjectileComponent>().setFlight(rng, sp, vel);
+	});
 }
 
+void AssetManager::PlaceSpider(Entity& monster, float x, float y, float s)
+{
+	auto& transform(monster.getComponent<TransformComponent>());
+	transform.position.x = x;
+	transform.position.y = y;
+	transform.scale = s;
+
+	auto& collider(monster.getComponent<ColliderComponent>());
+	collider.offsetX = collider.collider.x = static_cast<int>(20 * s);
+	collider.offsetY = collider.collider.y = static_cast<int>(20 * s);
+	collider.collider.w = collider.collider.h = static_cast<int>(24 * s);
+}
 
 void AssetManager::CreateSpider(float x, float y, float s) {
-	auto& monster(manager->addEntity());
-	monster.addComponent<TransformComponent>(x, y, 64, 64, s);  // (5 * TILE_SIZE, 2 * TILE_SIZE);
-	monster.getComponent<TransformComponent>().speed = 2.5;
-	monster.getComponent<TransformComponent>().speedLo = 1.0;
-	monster.getComponent<TransformComponent>().speedHi = 3.5;
-	monster.addComponent<SpriteComponent>("monster", true);
-	monster.getComponent<SpriteComponent>().animIndex = 0;
-	monster.getComponent<SpriteComponent>().Play("MonsterWalk");
-	monster.addComponent<ColliderComponent>("monster", 20*s, 20*s, 24*s, 24*s);
-	monster.addGroup(Game::groupMonsters);
+	spiderPrefab.instantiate(*manager, [x, y, s](Entity& monster)
+	{
+		PlaceSpider(monster, x, y, s);
+	});
+}
+
+void AssetManager::CreateSpiders(std::size_t count)
+{
+	spiderPrefab.instantiate(*manager, count, [](Entity& monster, std::size_t)
+	{
+		float s = .2 + (static_cast<float>(rand())) / (static_cast<float>(RAND_MAX / (1.5 - .2)));
+		PlaceSpider(monster, rand() % -200, rand() % 100, s);
+	});
 }
 
 
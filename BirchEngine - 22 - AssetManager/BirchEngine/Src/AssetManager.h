@@ -15,6 +15,9 @@ public:
 
 	// Game Objects
 
+	// builds the prefabs below; call once the textures they use have been added
+	void CreatePrefabs();
+
 	/*
 	Arguments:
 		pos := position
@@ -24,7 +27,9 @@ public:
 	*/
 	void CreateProjectile(Vector2D pos, Vector2D vel, int rng, int sp, std::string texID);
 	//init_x, init_y, scale
-	void AssetManager::CreateSpider(float x, float y, float s);
+	void CreateSpider(float x, float y, float s);
+	// count spiders at random positions and scales, all in one go
+	void CreateSpiders(std::size_t count);
 
 	// Texture Management
 	void AddTexture(std::string id, const char * path);
@@ -34,5 +39,12 @@ private:
 	// Manager * manager;
 	// associate textures with id:
 	std::map<std::string, SDL_Texture*> textures;
+
+	// entities are stamped out of these instead of being put together one component at a time
+	Prefab projectilePrefab;
+	Prefab spiderPrefab;
+
+	// gives a spider stamped out of spiderPrefab its place and size
+	static void PlaceSpider(Entity& monster, float x, float y, float s);
 	
 };
\ No newline at end of file
@@ -0,0 +1,127 @@
+/*
+Times a query's signature test, "has all of these and none of those", with
+std::bitset (what the ECS used before) and with WideBitSet::matches(), at the
+old 32-bit signature width and at 256 bits with a growing number of types.
+
+Not part of the game build (it has its own main()). Build it with
+optimisations on, from Src, eg.
+	g++ -std=c++14 -O2 Bench/SignatureBench.cpp -o signature-bench
+or in a Release x64 Developer Command Prompt
+	cl /std:c++14 /O2 /EHsc Bench\SignatureBench.cpp
+Each case is timed several times and the fastest run is reported, which keeps
+out most of the noise from whatever else the machine is doing.
+*/
+#include <bitset>
+#include <vector>
+#include <utility>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include "../ECS/WideBitSet.h"
+
+static const int runs = 7;
+static const int repeats = 200; // passes over every query and signature per run
+static const std::size_t signatureCount = 1024; // about one per archetype, generously
+static const std::size_t queryCount = 64;
+
+template <std::size_t N>
+static bool bitsetMatches(const std::bitset<N>& mSignature, const std::bitset<N>& mRequired, const std::bitset<N>& mExcluded)
+{
+	return (mSignature & mRequired) == mRequired && (mSignature & mExcluded).none();
+}
+
+// nanoseconds per signature test, the fastest of several runs; mHits counts the matches, to compare the two
+template <typename Set, typename F>
+static double timeMatches(const std::vector<Set>& mSignatures, const std::vector<std::pair<Set, Set>>& mQueries, F matches, long& mHits)
+{
+	double best = 0;
+	for (int run = 0; run < runs; run++)
+	{
+		long hits = 0;
+		auto start(std::chrono::steady_clock::now());
+		for (int r = 0; r < repeats; r++)
+		{
+			for (auto& q : mQueries)
+			{
+				for (auto& s : mSignatures) hits += matches(s, q.first, q.second);
+			}
+		}
+		auto end(std::chrono::steady_clock::now());
+
+		double ns = std::chrono::duration<double, std::nano>(end - start).count() /
+			(static_cast<double>(repeats) * mQueries.size() * mSignatures.size());
+		if (run == 0 || ns < best) best = ns;
+		mHits = hits;
+	}
+	return best;
+}
+
+// N bits of signature, with component IDs spread over the first mTypes of them
+template <std::size_t N>
+static bool compare(std::size_t mTypes)
+{
+	// the same random sets for both, six components per entity and three per query
+	std::mt19937 random(7);
+	std::vector<std::bitset<N>> bitsets;
+	std::vector<WideBitSet<N>> wides;
+	for (std::size_t i = 0; i < signatureCount; i++)
+	{
+		std::bitset<N> b;
+		WideBitSet<N> w;
+		for (int c = 0; c < 6; c++)
+		{
+			std::size_t id = random() % mTypes;
+			b[id] = true;
+			w[id] = true;
+		}
+		bitsets.push_back(b);
+		wides.push_back(w);
+	}
+
+	std::vector<std::pair<std::bitset<N>, std::bitset<N>>> bitsetQueries;
+	std::vector<std::pair<WideBitSet<N>, WideBitSet<N>>> wideQueries;
+	for (std::size_t i = 0; i < queryCount; i++)
+	{
+		std::bitset<N> required, excluded;
+		WideBitSet<N> wideRequired, wideExcluded;
+		for (int c = 0; c < 2; c++)
+		{
+			std::size_t id = random() % mTypes;
+			required[id] = true;
+			wideRequired[id] = true;
+		}
+		std::size_t id = random() % mTypes;
+		excluded[id] = true;
+		wideExcluded[id] = true;
+		bitsetQueries.emplace_back(required, excluded);
+		wideQueries.emplace_back(wideRequired, wideExcluded);
+	}
+
+	long bitsetHits = 0, wideHits = 0;
+	double bitsetNs = timeMatches(bitsets, bitsetQueries, [](const std::bitset<N>& s, const std::bitset<N>& r, const std::bitset<N>& e)
+	{
+		return bitsetMatches(s, r, e);
+	}, bitsetHits);
+	double wideNs = timeMatches(wides, wideQueries, [](const WideBitSet<N>& s, const WideBitSet<N>& r, const WideBitSet<N>& e)
+	{
+		return s.matches(r, e);
+	}, wideHits);
+
+	std::printf("%3u bits, %3u types: std::bitset %6.2f ns   WideBitSet %6.2f ns   (%ld matches)\n",
+		static_cast<unsigned>(N), static_cast<unsigned>(mTypes), bitsetNs, wideNs, bitsetHits);
+	if (bitsetHits != wideHits)
+	{
+		std::printf("  the two disagree: WideBitSet found %ld\n", wideHits);
+		return false;
+	}
+	return true;
+}
+
+int main()
+{
+	bool agreed = compare<32>(32);
+	agreed = compare<256>(32) && agreed;
+	agreed = compare<256>(128) && agreed;
+	agreed = compare<256>(256) && agreed;
+	return agreed ? 0 : 1;
+}
@@ -18,9 +18,10 @@ bool Collision::AABB(const SDL_Rect& recA, const SDL_Rect& recB)
 
 bool Collision::AABB(const ColliderComponent & colA, const ColliderComponent & colB)
 {
-	if (AABB(colA.collider, colB.collider))
+	// layers that ignore each other never collide, and cost no more than an AND to rule out
+	if (colA.collidesWith(colB) && AABB(colA.collider, colB.collider))
 	{
-		// std::cout << colA.tag << " collided with " << colB.tag << std::endl;
+		// std::cout << colA.tag() << " collided with " << colB.tag() << std::endl;
 		return true;
 	}
 	else
@@ -15,5 +15,6 @@ public:
 	overlap on their respective axes.
 	*/
 	static bool AABB(const SDL_Rect& recA, const SDL_Rect& recB);
+	// also false if their layers don't collide; see CollisionLayer
 	static bool AABB(const ColliderComponent& colA, const ColliderComponent& colB);
 };
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include "CollisionGrid.h"
+#include <algorithm>
+
+CollisionGrid::CollisionGrid(int mWidth, int mHeight, int mCellSize)
+	: gridWidth(mWidth), gridHeight(mHeight), size(mCellSize),
+	bits((static_cast<std::size_t>(mWidth) * mHeight + 63) / 64, 0)
+{}
+
+void CollisionGrid::setSolid(int x, int y, bool mSolid)
+{
+	if (x < 0 || y < 0 || x >= gridWidth || y >= gridHeight) return;
+	std::size_t i = static_cast<std::size_t>(y) * gridWidth + x;
+	if (mSolid) bits[i / 64] |= std::uint64_t(1) << (i % 64);
+	else bits[i / 64] &= ~(std::uint64_t(1) << (i % 64));
+}
+
+bool CollisionGrid::overlaps(const SDL_Rect& mBox) const
+{
+	/*
+	Tile t spans [t * size, t * size + size] and touching counts, so the box
+	[x, x + w] reaches tiles cellOf(x - 1) (whose right edge may be x) up to
+	cellOf(x + w).
+	*/
+	int x0 = std::max(cellOf(mBox.x - 1), 0);
+	int y0 = std::max(cellOf(mBox.y - 1), 0);
+	int x1 = std::min(cellOf(mBox.x + mBox.w), gridWidth - 1);
+	int y1 = std::min(cellOf(mBox.y + mBox.h), gridHeight - 1);
+
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			if (isSolid(x, y)) return true;
+		}
+	}
+	return false;
+}
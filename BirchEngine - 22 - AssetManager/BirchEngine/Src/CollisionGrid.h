@@ -0,0 +1,61 @@
+#pragma once
+#include <SDL.h>
+#include <vector>
+#include <cstdint>
+
+/*
+The solid parts of a tile map, one bit per tile. Testing a box against it
+only looks at the few tiles under the box, so it costs the same however big
+the map is, and the whole collider layer of a map takes a few bytes instead
+of an entity per solid tile.
+
+A tile counts as a box cellSize wide at (x * cellSize, y * cellSize), with
+the same edges-touching-counts rule as Collision::AABB(). Anything off the
+grid is empty.
+*/
+class CollisionGrid
+{
+public:
+	CollisionGrid() = default;
+	CollisionGrid(int mWidth, int mHeight, int mCellSize);
+
+	int width() const { return gridWidth; }
+	int height() const { return gridHeight; }
+	int cellSize() const { return size; }
+
+	void setSolid(int x, int y, bool mSolid = true);
+	bool isSolid(int x, int y) const
+	{
+		if (x < 0 || y < 0 || x >= gridWidth || y >= gridHeight) return false;
+		std::size_t i = static_cast<std::size_t>(y) * gridWidth + x;
+		return (bits[i / 64] >> (i % 64)) & 1u;
+	}
+
+	// true if mBox overlaps (or touches) any solid tile
+	bool overlaps(const SDL_Rect& mBox) const;
+
+	// calls f(int x, int y) for every solid tile
+	template <typename F>
+	void eachSolid(F f) const
+	{
+		for (int y = 0; y < gridHeight; y++)
+		{
+			for (int x = 0; x < gridWidth; x++)
+			{
+				if (isSolid(x, y)) f(x, y);
+			}
+		}
+	}
+
+private:
+	int gridWidth = 0;
+	int gridHeight = 0;
+	int size = 1;
+	std::vector<std::uint64_t> bits;
+
+	// the tile v falls in, rounding down for negative coordinates too
+	int cellOf(int v) const
+	{
+		return (v >= 0) ? v / size : (v - size + 1) / size;
+	}
+};
@@ -1,32 +1,69 @@
 #pragma once
-#include <string>
+#include <cstdint>
 #include "SDL.h"
 #include "Components.h"
 #include "../TextureManager.h"
+#include "../AssetManager.h"
 #include <iostream>
 
+/*
+What a collider is, one bit each, so that a mask can name several at once.
+A collider's mask says which layers it collides with; two colliders collide
+only if each one's mask has the other's layer, so a broadphase can throw out
+a pair with an AND before looking at either box.
+*/
+enum CollisionLayer : std::uint32_t
+{
+	PlayerLayer = 1u << 0,
+	MonsterLayer = 1u << 1,
+	ProjectileLayer = 1u << 2,
+	// the map's CollisionGrid; there are no terrain colliders, but masks can name it
+	TerrainLayer = 1u << 3
+};
+
+// what each layer collides with unless told otherwise. Spiders walk through walls.
+inline std::uint32_t defaultCollisionMask(std::uint32_t mLayer)
+{
+	switch (mLayer)
+	{
+	case PlayerLayer:
+		return MonsterLayer | TerrainLayer;
+	case MonsterLayer:
+		return PlayerLayer | ProjectileLayer;
+	case ProjectileLayer:
+		return MonsterLayer | TerrainLayer;
+	case TerrainLayer:
+		return PlayerLayer | ProjectileLayer;
+	default:
+		return 0;
+	}
+}
+
 class ColliderComponent : public Component
 {
 public:
 
 	SDL_Rect collider;
-	std::string tag;
+	std::uint32_t layer;
+	std::uint32_t mask;
 
 	SDL_Texture* texture;
 	SDL_Rect srcRect, destRect;
 
 	TransformComponent* transform;
-	int offsetX;
-	int offsetY;
+	int offsetX = 0;
+	int offsetY = 0;
 
-	ColliderComponent(std::string t)
+	ColliderComponent(std::uint32_t mLayer)
 	{
-		tag = t;
+		layer = mLayer;
+		mask = defaultCollisionMask(mLayer);
 	}
 
-	ColliderComponent(std::string t, int posX, int posY, int width, int height)
+	ColliderComponent(std::uint32_t mLayer, int posX, int posY, int width, int height)
 	{
-		this->tag = t;
+		this->layer = mLayer;
+		this->mask = defaultCollisionMask(mLayer);
 		this->offsetX = posX;
 		this->offsetY = posY;
 		this->collider.x = offsetX;
@@ -39,25 +76,49 @@ public:
 	{
 		if (!entity->hasComponent<TransformComponent>())
 		{
+			// that moves us to another archetype row, so the copy there finishes the job
 			entity->addComponent<TransformComponent>();
+			entity->getComponent<ColliderComponent>().init();
+			return;
 		}
 
 		transform = &entity->getComponent<TransformComponent>();
 		
-		texture = TextureManager::LoadTexture("Assets/collider.png");
+		// loaded once by Game::init(), not once per collider
+		texture = Game::assets->GetTexture("collider");
 
 		srcRect = { 0,0,TILE_SIZE,TILE_SIZE };
 		destRect = { collider.x,collider.y,collider.w,collider.h };
 	}
 
-	void update() override
+	void relink() override
+	{
+		transform = &entity->getComponent<TransformComponent>();
+	}
+
+	// true if the layers of the two collide, wherever their boxes are
+	bool collidesWith(const ColliderComponent& other) const
+	{
+		return (mask & other.layer) && (other.mask & layer);
+	}
+
+	// the layer's name, for debugging output only
+	const char* tag() const
 	{
-		// NOTE: Terrain colliders are drawn in the Collisions section of Game.cpp
-		if (tag != "terrainCollider") // colliders associated with terrain won't have a transform component
+		switch (layer)
 		{
-			collider.x = static_cast<int>(transform->position.x) + offsetX;
-			collider.y = static_cast<int>(transform->position.y) + offsetY;
+		case PlayerLayer: return "player";
+		case MonsterLayer: return "monster";
+		case ProjectileLayer: return "projectile";
+		case TerrainLayer: return "terrainCollider";
+		default: return "collider";
 		}
+	}
+
+	void update() override
+	{
+		collider.x = static_cast<int>(transform->position.x) + offsetX;
+		collider.y = static_cast<int>(transform->position.y) + offsetY;
 
 		// Use the commented code below if using camera. See video # 21 @ 09:05
 		// https://www.youtube.com/watch?v=rP62bS0k3nU&t=654s
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <type_traits>
+
+/*
+A list of types that only exists at compile time.
+*/
+template <typename... Ts> struct TypeList {};
+
+template <typename List> struct TypeListSize;
+template <typename... Ts> struct TypeListSize<TypeList<Ts...>>
+	: std::integral_constant<std::size_t, sizeof...(Ts)> {};
+
+template <typename T> struct AlwaysFalse : std::false_type {};
+
+// position of T in a TypeList
+template <typename T, typename List> struct TypeIndex;
+
+template <typename T> struct TypeIndex<T, TypeList<>>
+{
+	static_assert(AlwaysFalse<T>::value, "this component type is not registered in ECS/ComponentList.h");
+	static constexpr std::size_t value = 0;
+};
+
+template <typename T, typename... Ts> struct TypeIndex<T, TypeList<T, Ts...>>
+	: std::integral_constant<std::size_t, 0> {};
+
+template <typename T, typename U, typename... Ts> struct TypeIndex<T, TypeList<U, Ts...>>
+	: std::integral_constant<std::size_t, 1 + TypeIndex<T, TypeList<Ts...>>::value> {};
+
+// whether T is in a TypeList
+template <typename T, typename List> struct TypeContains;
+
+template <typename T> struct TypeContains<T, TypeList<>> : std::false_type {};
+
+template <typename T, typename... Ts> struct TypeContains<T, TypeList<T, Ts...>> : std::true_type {};
+
+template <typename T, typename U, typename... Ts> struct TypeContains<T, TypeList<U, Ts...>>
+	: TypeContains<T, TypeList<Ts...>> {};
+
+// one TypeList made of two
+template <typename List1, typename List2> struct TypeListConcat;
+
+template <typename... Ts, typename... Us> struct TypeListConcat<TypeList<Ts...>, TypeList<Us...>>
+{
+	using type = TypeList<Ts..., Us...>;
+};
+
+class TransformComponent;
+class SpriteComponent;
+class KeyboardController;
+class ColliderComponent;
+class TileComponent;
+class ProjectileComponent;
+
+/*
+Every component type in the game. A component's ID is its position in this
+list, so a new component has to be added here before an entity can hold it.
+Only the class names are needed here, not their definitions.
+*/
+using ComponentList = TypeList<
+	TransformComponent,
+	SpriteComponent,
+	KeyboardController,
+	ColliderComponent,
+	TileComponent,
+	ProjectileComponent
+>;
+
+/*
+Tags are components without any data: an entity has one or it doesn't. They
+take a bit in the signature like any component, so queries can ask for them
+(or, with without<T>(), for their absence), but they have no archetype
+column and cost nothing per entity. Being only names, they are
+defined right here. Entity::addTag<T>() gives an entity a tag.
+*/
+struct MapBGTag {};
+struct MapTag {};
+struct MapFXTag {};
+struct PlayerTag {};
+struct MonsterTag {};
+
+using TagList = TypeList<
+	MapBGTag,
+	MapTag,
+	MapFXTag,
+	PlayerTag,
+	MonsterTag
+>;
+
+struct EntityDestroyed;
+struct CollisionBegan;
+struct ProjectileHit;
+
+/*
+Every event type (see EventQueue). Like a component's, an event's ID is its
+position in this list, so the Manager keeps its queues in a plain array.
+*/
+using EventList = TypeList<
+	EntityDestroyed,
+	CollisionBegan,
+	ProjectileHit
+>;
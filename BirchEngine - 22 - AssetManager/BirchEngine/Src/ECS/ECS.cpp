@@ -1,7 +1,549 @@
 #include "ECS.h"
 
-void Entity::addGroup(Group mGroup)
+Entity::~Entity()
 {
-	groupBitSet[mGroup] = true;
-	manager.addToGroup(this, mGroup);
+	destroyComponents();
+}
+
+// the rows they are in are left for the caller to drop
+void Entity::destroyComponents()
+{
+	for (ComponentID id : components) componentArray[id]->~Component();
+}
+
+/*
+Called by Manager::refresh() once a destroyed entity has left its archetype,
+which destroyed its components. The slot keeps its Entity object (and its
+vectors' capacity) for the next addEntity(), but under a new generation so
+old handles stop matching.
+*/
+void Entity::release()
+{
+	components.clear();
+	componentArray.fill(nullptr);
+	componentBitSet.reset();
+	sleeping = false;
+	handle.generation++;
+}
+
+void Entity::revive()
+{
+	active = true;
+}
+
+std::uint32_t Entity::getChangeTick(ComponentID id) const
+{
+	// no row to read, and maybe no archetype either
+	if (!componentBitSet[id]) return 0;
+	return archetype->getChangeTick(archetypeRow, id);
+}
+
+void Entity::initComponents()
+{
+	// an init() may add a component of its own, which addComponent() has already init()ed
+	std::size_t n = components.size();
+	for (std::size_t i = 0; i < n; i++) componentArray[components[i]]->init();
+}
+
+void Entity::destroy()
+{
+	if (!active) return;
+	active = false;
+	manager.markDirty(*this);
+}
+
+// an entity still being put together (no archetype yet) is placed by whatever completes it
+void Entity::sleep()
+{
+	if (sleeping) return;
+	sleeping = true;
+	if (archetype) manager.updateArchetype(*this);
+}
+
+void Entity::wake()
+{
+	if (!sleeping) return;
+	sleeping = false;
+	if (archetype) manager.updateArchetype(*this);
+}
+
+void Entity::addTag(ComponentID mTag)
+{
+	assert(mTag >= firstTagID && mTag < TypeListSize<RegisteredTypes>::value && "addTag() takes the ID of a type from TagList");
+	if (componentBitSet[mTag]) return;
+	componentBitSet[mTag] = true;
+	manager.updateArchetype(*this);
+}
+
+void Entity::removeTag(ComponentID mTag)
+{
+	assert(mTag >= firstTagID && mTag < TypeListSize<RegisteredTypes>::value && "removeTag() takes the ID of a type from TagList");
+	if (!componentBitSet[mTag]) return;
+	componentBitSet[mTag] = false;
+	manager.updateArchetype(*this);
+}
+
+constexpr std::size_t Archetype::chunkSize;
+
+Archetype::Archetype(const ComponentBitSet& mSignature, const std::array<const ComponentStorage*, firstTagID>& mStorage)
+	: signature(mSignature)
+{
+	for (ComponentID id = 0; id < firstTagID; id++)
+	{
+		if (!signature[id]) continue;
+		assert(mStorage[id] && "a component type the Manager doesn't know how to store; see Manager::registerComponent()");
+
+		// each column starts aligned for its type; new char[] is aligned for anything
+		const ComponentStorage& s(*mStorage[id]);
+		chunkBytes = (chunkBytes + s.alignment - 1) / s.alignment * s.alignment;
+		columnOf[id] = columns.size();
+		columns.push_back(Column{ id, &s, chunkBytes });
+		chunkBytes += s.size * chunkSize;
+	}
+}
+
+std::unique_ptr<Archetype::Chunk> Archetype::newChunk() const
+{
+	std::unique_ptr<Chunk> chunk(new Chunk());
+	chunk->components.reset(new char[chunkBytes]);
+	chunk->changeTicks.reset(new std::uint32_t[columns.size() * chunkSize]);
+	return chunk;
+}
+
+void Archetype::reserve(std::size_t n)
+{
+	while (chunks.size() * chunkSize < count + n) chunks.emplace_back(newChunk());
+}
+
+std::size_t Archetype::add(Entity* mEntity)
+{
+	std::size_t row = count++;
+	if (row / chunkSize == chunks.size()) chunks.emplace_back(newChunk());
+	chunks[row / chunkSize]->entities[row % chunkSize] = mEntity;
+	return row;
+}
+
+Entity* Archetype::remove(std::size_t row)
+{
+	std::size_t last = --count;
+	if (row == last) return nullptr;
+
+	// swap-and-pop: the last row fills the hole
+	for (auto& column : columns)
+	{
+		column.storage->move(slot(last, column.id), slot(row, column.id));
+		setChangeTick(row, column.id, getChangeTick(last, column.id));
+	}
+	Entity* moved = chunks[last / chunkSize]->entities[last % chunkSize];
+	chunks[row / chunkSize]->entities[row % chunkSize] = moved;
+	return moved;
+}
+
+void Prefab::registerParts(Manager& mManager) const
+{
+	for (auto& p : parts) mManager.registerComponent(p.id, *p.storage);
+}
+
+void Prefab::reserveRows(Manager& mManager, std::size_t n) const
+{
+	if (signature.none()) return;
+	registerParts(mManager);
+	mManager.getArchetype(signature).reserve(n);
+}
+
+void Prefab::place(Entity& mEntity) const
+{
+	mEntity.componentBitSet |= signature;
+	if (mEntity.componentBitSet.none()) return;
+
+	Manager& manager(mEntity.manager);
+	registerParts(manager);
+	std::size_t row;
+	Archetype* to = manager.openRow(mEntity, row);
+	for (auto& p : parts)
+	{
+		Component* c = p.storage->copy(*p.prototype, to->slot(row, p.id));
+		c->entity = &mEntity;
+		mEntity.componentArray[p.id] = c;
+		mEntity.components.push_back(p.id);
+		to->setChangeTick(row, p.id, manager.getChangeTick());
+	}
+	manager.closeRow(mEntity, *to, row);
+}
+
+constexpr std::size_t Manager::entityPageSize;
+
+// the entities go first: ~Entity() destroys its components, which live in the archetypes' chunks
+Manager::~Manager()
+{
+	// lets running jobs finish before what they may be looking at goes away
+	threadPool.reset();
+	for (std::size_t i = 0; i < entityCount; i++) entityAt(i).~Entity();
+}
+
+Archetype& Manager::getArchetype(const ComponentBitSet& mSignature)
+{
+	auto found(archetypeIndex.find(mSignature));
+	if (found != archetypeIndex.end()) return *found->second;
+
+	Archetype* a = new Archetype(mSignature, storage);
+	archetypes.emplace_back(a);
+	archetypeIndex.emplace(mSignature, a);
+
+	// the only time a query's list of archetypes has to change
+	for (auto& q : queries)
+	{
+		if (q.second->matches(mSignature)) q.second->archetypes.push_back(a);
+	}
+	return *a;
+}
+
+Query& Manager::getQuery(const ComponentBitSet& mRequired, const ComponentBitSet& mExcluded)
+{
+	std::lock_guard<std::mutex> lock(queryMutex);
+	QueryKey key{ mRequired, mExcluded };
+	auto found(queries.find(key));
+	if (found != queries.end()) return *found->second;
+
+	Query* q = new Query(mRequired, mExcluded);
+	for (auto& a : archetypes)
+	{
+		if (q->matches(a->getSignature())) q->archetypes.push_back(a.get());
+	}
+	queries.emplace(key, std::unique_ptr<Query>(q));
+	return *q;
+}
+
+Archetype* Manager::openRow(Entity& mEntity, std::size_t& mRow)
+{
+	Archetype& to(getArchetype(mEntity.getSignature()));
+	if (&to == mEntity.archetype) return nullptr;
+
+	mRow = to.add(&mEntity);
+	return &to;
+}
+
+void Manager::closeRow(Entity& mEntity, Archetype& mTo, std::size_t mRow)
+{
+	Archetype* from = mEntity.archetype;
+	std::size_t fromRow = mEntity.archetypeRow;
+	mEntity.archetype = &mTo;
+	mEntity.archetypeRow = mRow;
+	if (!from) return;
+
+	for (auto& column : from->columns)
+	{
+		// not in mTo any more: already destroyed
+		if (!mTo.signature[column.id]) continue;
+
+		mEntity.componentArray[column.id] = column.storage->move(from->slot(fromRow, column.id), mTo.slot(mRow, column.id));
+		mTo.setChangeTick(mRow, column.id, from->getChangeTick(fromRow, column.id));
+	}
+	dropRow(*from, fromRow);
+
+	// the ones that are new here haven't been init()ed yet
+	for (ComponentID id : mEntity.components)
+	{
+		if (from->signature[id]) mEntity.componentArray[id]->relink();
+	}
+}
+
+void Manager::updateArchetype(Entity& mEntity)
+{
+	if (mEntity.componentBitSet.none())
+	{
+		leaveArchetype(mEntity);
+		return;
+	}
+
+	std::size_t row;
+	if (Archetype* to = openRow(mEntity, row)) closeRow(mEntity, *to, row);
+}
+
+void Manager::leaveArchetype(Entity& mEntity)
+{
+	if (!mEntity.archetype) return;
+
+	mEntity.destroyComponents();
+	dropRow(*mEntity.archetype, mEntity.archetypeRow);
+	mEntity.archetype = nullptr;
+}
+
+void Manager::dropRow(Archetype& mArchetype, std::size_t row)
+{
+	Entity* moved = mArchetype.remove(row);
+	if (!moved) return;
+
+	moved->archetypeRow = row;
+	relocate(*moved);
+}
+
+void Manager::relocate(Entity& mEntity)
+{
+	Archetype& a(*mEntity.archetype);
+	for (auto& column : a.columns)
+	{
+		mEntity.componentArray[column.id] = column.storage->at(a.slot(mEntity.archetypeRow, column.id));
+	}
+	for (ComponentID id : mEntity.components) mEntity.componentArray[id]->relink();
+}
+
+thread_local CommandBuffer* Manager::jobCommands = nullptr;
+thread_local const Manager* Manager::jobManager = nullptr;
+
+void Manager::submit(std::function<void(CommandBuffer&)> mJob)
+{
+	std::uint64_t id;
+	CommandBuffer* buffer;
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		id = jobsSubmitted++;
+		if (!spareJobCommands.empty())
+		{
+			buffer = spareJobCommands.back().release();
+			spareJobCommands.pop_back();
+		}
+		else
+		{
+			buffer = new CommandBuffer();
+		}
+	}
+
+	getThreadPool().submit([this, id, buffer, mJob]()
+	{
+		CommandBuffer* outerCommands = jobCommands;
+		const Manager* outerManager = jobManager;
+		jobCommands = buffer;
+		jobManager = this;
+		mJob(*buffer);
+		jobCommands = outerCommands;
+		jobManager = outerManager;
+
+		std::lock_guard<std::mutex> lock(jobMutex);
+		finishedJobs.emplace_back(id, std::unique_ptr<CommandBuffer>(buffer));
+	});
+}
+
+void Manager::refresh()
+{
+	// finished jobs first, and only up to the first one still running, so they land in submit() order
+	std::vector<std::unique_ptr<CommandBuffer>> jobs;
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		std::sort(finishedJobs.begin(), finishedJobs.end(),
+			[](const std::pair<std::uint64_t, std::unique_ptr<CommandBuffer>>& j1,
+				const std::pair<std::uint64_t, std::unique_ptr<CommandBuffer>>& j2) { return j1.first < j2.first; });
+		std::size_t ready = 0;
+		while (ready < finishedJobs.size() && finishedJobs[ready].first == jobsApplied + ready) ready++;
+		for (std::size_t i = 0; i < ready; i++) jobs.push_back(std::move(finishedJobs[i].second));
+		finishedJobs.erase(finishedJobs.begin(), finishedJobs.begin() + ready);
+	}
+	if (!jobs.empty())
+	{
+		CommandBuffer::flush(*this, jobs);
+
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobsApplied += jobs.size();
+		for (auto& b : jobs) spareJobCommands.push_back(std::move(b));
+	}
+
+	CommandBuffer::flush(*this, commandBuffers);
+
+	EventQueue<EntityDestroyed>* destroyed = findEvents<EntityDestroyed>();
+	for (Entity* e : dirtyEntities)
+	{
+		if (destroyed) destroyed->emit(EntityDestroyed{ e->handle });
+		e->dirty = false;
+		leaveArchetype(*e);
+		e->release();
+		freeEntities.push_back(e->handle.index);
+		freeEntitiesSorted = false;
+	}
+	dirtyEntities.clear();
+}
+
+void Manager::dispatchEvents()
+{
+	bool dispatched = true;
+	while (dispatched)
+	{
+		dispatched = false;
+		// in EventList order; a queue a handler creates is picked up in the same pass
+		for (std::size_t i = 0; i < eventQueues.size(); i++)
+		{
+			if (eventQueues[i] && eventQueues[i]->dispatch()) dispatched = true;
+		}
+	}
+}
+
+void Manager::compact()
+{
+	for (auto& a : archetypes) a->shrink();
+	if (!freeEntitiesSorted)
+	{
+		// highest first: addEntity() pops from the back
+		std::sort(freeEntities.begin(), freeEntities.end(), std::greater<std::uint32_t>());
+		freeEntitiesSorted = true;
+	}
+}
+
+constexpr std::size_t CommandBuffer::none;
+
+void CommandBuffer::flush(Manager& mManager, const std::vector<std::unique_ptr<CommandBuffer>>& mBuffers)
+{
+	struct Piece
+	{
+		CommandBuffer* buffer;
+		std::size_t segment;
+	};
+	std::vector<Piece> pieces;
+
+	// running a command may record more (eg. a component's init() spawning something)
+	for (;;)
+	{
+		pieces.clear();
+		for (auto& b : mBuffers)
+		{
+			if (b->empty()) continue;
+
+			b->flushCommands.swap(b->commands);
+			b->flushDestroys.swap(b->destroys);
+			b->flushSegments.swap(b->segments);
+			b->created.assign(b->creates, nullptr);
+			b->creates = 0;
+			b->taskVersion = 0;
+			for (std::size_t s = 0; s < b->flushSegments.size(); s++) pieces.push_back(Piece{ b.get(), s });
+		}
+		if (pieces.empty()) break;
+
+		/*
+		Task order. Jobs' buffers all record under the same key, so the sort is
+		stable to keep those in the order they were handed in; otherwise no two
+		segments share a task. Either way the order is the same every time.
+		*/
+		std::stable_sort(pieces.begin(), pieces.end(), [](const Piece& p1, const Piece& p2)
+		{
+			return p1.buffer->flushSegments[p1.segment].task < p2.buffer->flushSegments[p2.segment].task;
+		});
+
+		/*
+		Size the entity slots, and the archetypes prefabs stamp into, once for the
+		whole batch. Which archetype a plain addComponent() ends up in depends on
+		everything else its entity gets, so those aren't sized up front.
+		*/
+		std::size_t entityAdds = 0;
+		std::vector<std::pair<const Prefab*, std::size_t>> instances;
+		for (auto& b : mBuffers)
+		{
+			entityAdds += b->created.size();
+			for (auto& c : b->flushCommands)
+			{
+				if (!c.prefab) continue;
+				auto found(std::find_if(instances.begin(), instances.end(),
+					[&c](const std::pair<const Prefab*, std::size_t>& i) { return i.first == c.prefab; }));
+				if (found != instances.end()) found->second++;
+				else instances.emplace_back(c.prefab, 1);
+			}
+		}
+		mManager.reserveEntities(entityAdds);
+		for (auto& i : instances) i.first->reserveRows(mManager, i.second);
+
+		// every entity first, so a command can use any entity its buffer promised
+		for (auto& p : pieces)
+		{
+			CommandBuffer& b(*p.buffer);
+			std::size_t end = b.segmentEnd(p.segment).creates;
+			for (std::size_t i = b.flushSegments[p.segment].creates; i < end; i++)
+			{
+				b.created[i] = &mManager.addEntity();
+			}
+		}
+
+		for (auto& p : pieces)
+		{
+			CommandBuffer& b(*p.buffer);
+			std::size_t end = b.segmentEnd(p.segment).commands;
+			for (std::size_t i = b.flushSegments[p.segment].commands; i < end; i++)
+			{
+				Command& c(b.flushCommands[i]);
+				Entity* e = (c.pending != none) ? b.created[c.pending] : mManager.getEntity(c.handle);
+				if (!e) continue;
+
+				c.apply(*e);
+			}
+		}
+
+		for (auto& p : pieces)
+		{
+			CommandBuffer& b(*p.buffer);
+			std::size_t end = b.segmentEnd(p.segment).destroys;
+			for (std::size_t i = b.flushSegments[p.segment].destroys; i < end; i++)
+			{
+				if (Entity* e = mManager.getEntity(b.flushDestroys[i])) e->destroy();
+			}
+		}
+
+		for (auto& b : mBuffers)
+		{
+			b->flushCommands.clear();
+			b->flushDestroys.clear();
+			b->flushSegments.clear();
+			b->created.clear();
+		}
+	}
+}
+
+void Manager::buildStages()
+{
+	stages.clear();
+	for (auto& s : systems)
+	{
+		bool fits = !stages.empty();
+		if (fits)
+		{
+			for (System* other : stages.back())
+			{
+				if (s->conflictsWith(*other))
+				{
+					fits = false;
+					break;
+				}
+			}
+		}
+
+		if (!fits) stages.emplace_back();
+		stages.back().push_back(s.get());
+	}
+}
+
+void Manager::update()
+{
+	changeTick++;
+	if (stages.empty()) buildStages();
+
+	for (auto& stage : stages)
+	{
+		if (stage.size() == 1)
+		{
+			stage[0]->update(*this);
+			continue;
+		}
+
+		std::size_t workload = 0;
+		for (System* s : stage)
+		{
+			std::size_t w = s->workload(*this);
+			workload = (w > std::numeric_limits<std::size_t>::max() - workload) ? std::numeric_limits<std::size_t>::max() : workload + w;
+		}
+		if (workload < serialStageWorkload)
+		{
+			for (System* s : stage) s->update(*this);
+			continue;
+		}
+
+		getThreadPool().run(stage.size(), [this, &stage](std::size_t i)
+		{
+			stage[i]->update(*this);
+		});
+	}
 }
@@ -2,13 +2,30 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <new>
 #include <algorithm>
-#include <bitset>
 #include <array>
+#include <unordered_map>
+#include <tuple>
+#include <utility>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <cassert>
+#include "ComponentList.h"
+#include "ThreadPool.h"
+#include "EventQueue.h"
+#include "WideBitSet.h"
 
 class Component;
 class Entity;
+class Archetype;
 class Manager;
+template <typename... Ts> class View;
+class Prefab;
 
 /*
 size_t is shorthand for the unsigned int size of a container.
@@ -17,37 +34,134 @@ we may have LOTS of components so it is good to have a large supply of IDs.
 using ComponentID = std::size_t;
 
 /*
-Every time we call this, lastID will remember what it was last.
-So when we return lastID++, we will get the next one.
+Entities are not allowed to hold more than this many components (tags included).
+Only the signatures are this wide; the per-entity and per-archetype arrays are
+sized by how many component types ComponentList.h actually registers.
 */
-using Group = std::size_t;
-inline ComponentID getNewComponentTypeID()
-{
-	static ComponentID lastID = 0u; // unsigned
-	return lastID++;
-}
+constexpr std::size_t maxComponents = 256;
+
+// every registered type: the components, whose IDs come first, then the tags
+using RegisteredTypes = TypeListConcat<ComponentList, TagList>::type;
+
+// IDs from here up to sleepingFlag are tags (see ComponentList.h), which have no archetype column
+constexpr ComponentID firstTagID = TypeListSize<ComponentList>::value;
+
+/*
+The last signature bit is not a component: it marks a sleeping entity (see
+Entity::sleep()). It sorts entities into archetypes, and so into queries, the
+same way a component would, but it has no archetype column.
+*/
+constexpr ComponentID sleepingFlag = maxComponents - 1;
+
+static_assert(TypeListSize<RegisteredTypes>::value <= sleepingFlag,
+	"ComponentList.h registers more component and tag types than maxComponents leaves room for");
 
 /*
-Gets a component's ID.
+Gets a component's ID: its position in ComponentList (see ComponentList.h),
+or for a tag, its position in TagList after all the components.
+It is worked out by the compiler, so getComponent<T>() and friends index
+straight into the entity's arrays with a constant.
 */
-template <typename T> inline ComponentID getComponentTypeID() noexcept
+template <typename T> constexpr ComponentID getComponentTypeID() noexcept
 {
-	static ComponentID typeID = getNewComponentTypeID();
-	return typeID;
+	return TypeIndex<T, RegisteredTypes>::value;
 }
 
-// Entities are not allowed to hold more than this many components
-constexpr std::size_t maxComponents = 32;
-constexpr std::size_t maxGroups = 32;
+template <typename T> struct IsTag : TypeContains<T, TagList> {};
+
+template <typename... Ts> struct AnyTag : std::false_type {};
+template <typename T, typename... Ts> struct AnyTag<T, Ts...>
+	: std::integral_constant<bool, IsTag<T>::value || AnyTag<Ts...>::value> {};
 
 /*
 These two lines define a component array for an entity, which will
 allow us to compare cap and compare components we already have so
-that duplicates are not introduced
+that duplicates are not introduced. Tags have no component, so the
+array stops at firstTagID.
+*/
+using ComponentBitSet = WideBitSet<maxComponents>;
+using ComponentArray = std::array<Component*, firstTagID>;
+
+/*
+The ComponentBitSet with a bit set for each of the given component types,
+eg. getComponentSignature<TransformComponent, ColliderComponent>().
+*/
+template <typename... Ts> constexpr ComponentBitSet getComponentSignature()
+{
+	return ComponentBitSet::of({ getComponentTypeID<Ts>()... });
+}
+
+// just the sleepingFlag bit, eg. to leave sleeping entities out of a query
+constexpr ComponentBitSet sleepingSignature = ComponentBitSet::of({ sleepingFlag });
+
+/*
+For the extra requirements of a view: with<Ts...>() are components or tags
+an entity must also have, without<Ts...>() ones it must not have, eg.
+	manager.view<TransformComponent>(with<MonsterTag>(), without<StunnedTag>())
 */
-using ComponentBitSet = std::bitset<maxComponents>;
-using GroupBitSet = std::bitset<maxGroups>;
-using ComponentArray = std::array<Component*, maxComponents>;
+struct With
+{
+	ComponentBitSet signature;
+};
+struct Without
+{
+	ComponentBitSet signature;
+};
+
+template <typename... Ts> constexpr With with()
+{
+	return With{ getComponentSignature<Ts...>() };
+}
+template <typename... Ts> constexpr Without without()
+{
+	return Without{ getComponentSignature<Ts...>() };
+}
+
+/*
+A handle names an entity slot in the Manager plus the generation of that slot.
+When an entity dies its slot is reused by the next addEntity() and the slot's
+generation goes up by one, so a handle kept around after its entity died no
+longer matches and Manager::isValid() / getEntity() can tell, instead of the
+old Entity* silently pointing at whatever moved into the slot.
+*/
+struct EntityHandle
+{
+	std::uint32_t index;
+	std::uint32_t generation;
+};
+
+inline bool operator==(const EntityHandle& h1, const EntityHandle& h2)
+{
+	return h1.index == h2.index && h1.generation == h2.generation;
+}
+inline bool operator!=(const EntityHandle& h1, const EntityHandle& h2)
+{
+	return !(h1 == h2);
+}
+
+// hashes the whole handle, generation included, so a reused slot is a different key
+namespace std
+{
+	template <>
+	struct hash<EntityHandle>
+	{
+		std::size_t operator()(const EntityHandle& mHandle) const
+		{
+			return std::hash<std::uint64_t>()((static_cast<std::uint64_t>(mHandle.index) << 32) | mHandle.generation);
+		}
+	};
+}
+
+/*
+Emitted by Manager::refresh() for every entity it cleans up, if anything has
+asked for the queue (see Manager::getEvents()). The handle is already stale
+by the time the event is handed out; it is only good for forgetting whatever
+was kept about the entity.
+*/
+struct EntityDestroyed
+{
+	EntityHandle entity;
+};
 
 // +------------------------+
 // | $$$ COMPONENT CLASS $$$|
@@ -58,12 +172,244 @@ class Component
 public:
 	Entity* entity;
 
+	/*
+	An init() may add a component to its own entity, but that moves the
+	entity to another archetype and this component along with it (see
+	Archetype), so it must not touch its members afterwards.
+	*/
 	virtual void init() {}
 	virtual void update() {}
 	virtual void draw() {}
+	/*
+	Called after our entity's components moved to another archetype row.
+	A component that keeps pointers to its siblings fetches them again here.
+	*/
+	virtual void relink() {}
 	virtual ~Component() {}
 };
 
+// +---------------------------------+
+// | $$$ COMPONENT STORAGE STRUCT $$$|
+// +---------------------------------+
+
+/*
+The components live by value in the archetypes' chunks (see Archetype),
+which don't know their types. This is what a chunk needs to know to keep
+one: its size and alignment, and how to move or copy one into a slot.
+Destroying one goes through the virtual ~Component(). componentStorage<T>
+is T's; see Manager::registerComponent().
+*/
+struct ComponentStorage
+{
+	std::size_t size;
+	std::size_t alignment;
+	// builds the component at mTo out of the one at mFrom, which it then destroys
+	Component* (*move)(void* mFrom, void* mTo);
+	// builds a copy of mPrototype at mTo
+	Component* (*copy)(const Component& mPrototype, void* mTo);
+	// the component built at mSlot
+	Component* (*at)(void* mSlot);
+};
+
+template <typename T> Component* moveComponent(void* mFrom, void* mTo)
+{
+	static_assert(alignof(T) <= alignof(std::max_align_t), "chunks only guarantee the alignment new does");
+	T& from(*static_cast<T*>(mFrom));
+	T* to = new (mTo) T(std::move(from));
+	from.~T();
+	return to;
+}
+
+template <typename T> Component* copyComponent(const Component& mPrototype, void* mTo)
+{
+	return new (mTo) T(static_cast<const T&>(mPrototype));
+}
+
+template <typename T> Component* componentAt(void* mSlot)
+{
+	return static_cast<T*>(mSlot);
+}
+
+template <typename T>
+constexpr ComponentStorage componentStorage{ sizeof(T), alignof(T), &moveComponent<T>, &copyComponent<T>, &componentAt<T> };
+
+// +------------------------+
+// | $$$ ARCHETYPE CLASS $$$|
+// +------------------------+
+
+/*
+An archetype holds every entity whose signature is exactly its own, along
+with their components. Those are packed into fixed-size chunks laid out as
+structure-of-arrays: one column of Entity*, plus one column per component
+type in the signature that holds the components themselves, by value, and
+one of their change ticks. A query for "Transform + Collider" only visits
+the archetypes whose signature has both bits, then streams down two columns
+of components per chunk instead of testing every entity and calling
+getComponent() on each one.
+
+Rows are kept dense; removing an entity moves the archetype's last row into
+the hole, so every chunk is full except the last one. A row's components
+move with it: when its entity changes archetype (a component or tag added,
+sleep(), wake()) and when it fills another's hole. The Manager then points
+the entity at its components again and calls relink() on them, since those
+cache pointers to their siblings in init() (eg. transform =
+&entity->getComponent<...>()). Nothing else is fixed up, so a reference to
+a component is only good until the next structural change, and whatever
+outlives a frame outside the ECS, like the collision broadphases, keeps
+EntityHandles and copies rather than component pointers.
+*/
+class Archetype
+{
+public:
+	static constexpr std::size_t chunkSize = 128; // rows per chunk
+
+	// mStorage must have an entry for every component type in mSignature
+	Archetype(const ComponentBitSet& mSignature, const std::array<const ComponentStorage*, firstTagID>& mStorage);
+
+	const ComponentBitSet& getSignature() const { return signature; }
+	// number of entities in the archetype
+	std::size_t size() const { return count; }
+	std::size_t chunkCount() const { return (count + chunkSize - 1) / chunkSize; }
+	// number of rows in use in chunk c
+	std::size_t chunkRows(std::size_t c) const { return std::min(chunkSize, count - c * chunkSize); }
+
+	// the Entity* column of chunk c
+	Entity* const* entities(std::size_t c) const { return chunks[c]->entities.data(); }
+	// the column of Ts of chunk c; T must be in the signature
+	template <typename T> T* column(std::size_t c) const
+	{
+		return reinterpret_cast<T*>(&chunks[c]->components[columns[columnOf[getComponentTypeID<T>()]].offset]);
+	}
+
+	// makes sure n more rows fit without allocating another chunk
+	void reserve(std::size_t n);
+
+private:
+	// they build and move the components in the rows
+	friend class Manager;
+	friend class Entity;
+	friend class Prefab;
+
+	struct Column
+	{
+		ComponentID id;
+		const ComponentStorage* storage;
+		std::size_t offset; // where the column starts in Chunk::components
+	};
+
+	struct Chunk
+	{
+		std::array<Entity*, chunkSize> entities;
+		std::unique_ptr<char[]> components; // the columns one after the other, chunkSize components each
+		std::unique_ptr<std::uint32_t[]> changeTicks; // chunkSize per column, in the same order
+	};
+
+	ComponentBitSet signature;
+	std::vector<Column> columns;
+	std::array<std::size_t, firstTagID> columnOf; // column of each component ID in the signature
+	std::size_t chunkBytes = 0; // size of Chunk::components
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	std::size_t count = 0;
+
+	// where row's component of type id is, or is to be built
+	void* slot(std::size_t row, ComponentID id) const
+	{
+		const Column& column(columns[columnOf[id]]);
+		return &chunks[row / chunkSize]->components[column.offset + (row % chunkSize) * column.storage->size];
+	}
+	// the Manager::getChangeTick() at which row's component id was added or last marked changed
+	std::uint32_t getChangeTick(std::size_t row, ComponentID id) const
+	{
+		return chunks[row / chunkSize]->changeTicks[columnOf[id] * chunkSize + row % chunkSize];
+	}
+	void setChangeTick(std::size_t row, ComponentID id, std::uint32_t tick)
+	{
+		chunks[row / chunkSize]->changeTicks[columnOf[id] * chunkSize + row % chunkSize] = tick;
+	}
+
+	std::unique_ptr<Chunk> newChunk() const;
+	// appends a row for mEntity and returns its row number; building its components is up to the caller
+	std::size_t add(Entity* mEntity);
+	/*
+	Removes a row whose components are already gone, destroyed or moved out,
+	by moving the last row into it. Returns the entity of the row that moved,
+	or nullptr.
+	*/
+	Entity* remove(std::size_t row);
+	// frees the chunks no row uses any more, but one, so a count hovering around a chunk boundary doesn't keep reallocating it
+	void shrink()
+	{
+		if (chunks.size() > chunkCount() + 1) chunks.resize(chunkCount() + 1);
+	}
+};
+
+// +--------------------+
+// | $$$ QUERY CLASS $$$|
+// +--------------------+
+
+/*
+"Every entity that has all of the required components and none of the
+excluded ones." A query keeps the list of archetypes that match it, and the
+Manager adds to that list whenever a new archetype appears. Entities join and
+leave a query on their own, because adding/removing a component or being
+destroyed already moves them between archetypes. So once created, a query
+costs nothing to keep up to date while membership is stable, and walking it
+never tests a signature.
+
+To pick out one kind of entity, give it a tag (see ComponentList.h): it then
+turns up in every query asking for that tag.
+Get one with Manager::getQuery(); the Manager owns it and hands back the same
+Query every time for the same signatures.
+*/
+class Query
+{
+public:
+	Query(const ComponentBitSet& mRequired, const ComponentBitSet& mExcluded)
+		: required(mRequired), excluded(mExcluded) {}
+
+	const ComponentBitSet& getRequired() const { return required; }
+	const ComponentBitSet& getExcluded() const { return excluded; }
+
+	bool matches(const ComponentBitSet& mSignature) const
+	{
+		return mSignature.matches(required, excluded);
+	}
+
+	// the matching archetypes; some of them may be empty at the moment
+	const std::vector<Archetype*>& getArchetypes() const { return archetypes; }
+
+	// number of matching entities
+	std::size_t size() const
+	{
+		std::size_t n = 0;
+		for (Archetype* a : archetypes) n += a->size();
+		return n;
+	}
+
+	// calls f(Entity&) for every matching entity
+	template <typename F>
+	void each(F f) const
+	{
+		for (std::size_t i = 0; i < archetypes.size(); i++)
+		{
+			Archetype& a(*archetypes[i]);
+			for (std::size_t c = 0; c < a.chunkCount(); c++)
+			{
+				Entity* const* entities = a.entities(c);
+				std::size_t rows = a.chunkRows(c);
+				for (std::size_t r = 0; r < rows; r++) f(*entities[r]);
+			}
+		}
+	}
+
+private:
+	friend class Manager;
+
+	ComponentBitSet required;
+	ComponentBitSet excluded;
+	std::vector<Archetype*> archetypes;
+};
+
 // +---------------------+
 // | $$$ ENTITY CLASS $$$|
 // +---------------------+
@@ -72,71 +418,442 @@ class Entity
 {
 private:
 	Manager& manager;
+	EntityHandle handle;
 	bool active = true;
-	std::vector<std::unique_ptr<Component>> components;
+	// IDs of our components in the order they were added, which is the order they update/draw in
+	std::vector<ComponentID> components;
 
+	// where our components are in our archetype row; kept up to date as the row moves
 	ComponentArray componentArray;
-	ComponentBitSet componentBitSet;
-	GroupBitSet groupBitSet;
+	ComponentBitSet componentBitSet; // our components and our tags
+	bool dirty = false; // queued for the next Manager::refresh()
+	bool sleeping = false;
+
+	// the archetype matching getSignature() and our row in it (nullptr while we have no components)
+	Archetype* archetype = nullptr;
+	std::size_t archetypeRow = 0;
+
+	void destroyComponents();
+
+	/*
+	How a Prefab stamps itself out: it copies each prepared component straight
+	into our row without calling init(), then initComponents() does that once
+	for the whole set.
+	*/
+	friend class Prefab;
+	void initComponents();
+
+	// only the Manager recycles entity slots
+	friend class Manager;
+	void release();
+	void revive();
 
 public:
 	// Note: lowercase m :=member variable
-	Entity(Manager& mManager) : manager(mManager) {}
+	Entity(Manager& mManager, EntityHandle mHandle) : manager(mManager), handle(mHandle) {}
+	// our components live in our archetype row, so copying an Entity would double-free them
+	Entity(const Entity&) = delete;
+	Entity& operator=(const Entity&) = delete;
+	~Entity();
+
 	void update()
 	{
-		for (auto& c : components) c->update();
+		for (ComponentID id : components) componentArray[id]->update();
 	}
 	void draw()
 	{
-		for (auto& c : components) c->draw();
+		for (ComponentID id : components) componentArray[id]->draw();
 	}
 	bool isActive() const { return active; }
-	// ComponentManager will loop through all components and destroy those that are inactive
-	void destroy() { active = false; }
+	EntityHandle getHandle() const { return handle; }
 
-	bool hasGroup(Group mGroup)
+	/*
+	A sleeping entity is skipped by every ComponentSystem, so it costs nothing
+	per frame; it is still drawn, still tagged and still found by views.
+	Map tiles and terrain colliders sleep from the moment they are loaded.
+	Whatever gives a sleeping entity something to do again (a velocity, an
+	edit to the map, ...) has to wake() it.
+
+	Both move the entity to another archetype, so from inside a system or a
+	loop over a view go through the command buffer:
+		commands.run(handle, [](Entity& e) { e.wake(); });
+	*/
+	void sleep();
+	void wake();
+	bool isSleeping() const { return sleeping; }
+	// the components we hold, plus sleepingFlag while asleep; picks our archetype
+	ComponentBitSet getSignature() const
 	{
-		return groupBitSet[mGroup];
+		return sleeping ? (componentBitSet | sleepingSignature) : componentBitSet;
 	}
+	// Manager::refresh() will take the entity out of its archetype and free its slot
+	void destroy();
 
-	void addGroup(Group mGroup);
-	void delGroup(Group mGroup)
+	/*
+	Tags move the entity to another archetype, like adding a component does;
+	the same rules apply inside systems and loops (see CommandBuffer::addTag()).
+	The ComponentID versions are for code that picks the tag at run time, eg.
+	Map::LoadMap() and the map layer it is loading.
+	*/
+	template <typename T> void addTag()
+	{
+		static_assert(IsTag<T>::value, "addTag<T>() takes a type from TagList in ECS/ComponentList.h");
+		addTag(getComponentTypeID<T>());
+	}
+	template <typename T> void removeTag()
+	{
+		static_assert(IsTag<T>::value, "removeTag<T>() takes a type from TagList in ECS/ComponentList.h");
+		removeTag(getComponentTypeID<T>());
+	}
+	template <typename T> bool hasTag() const
 	{
-		groupBitSet[mGroup] = false;
+		return componentBitSet[getComponentTypeID<T>()];
 	}
+	void addTag(ComponentID mTag);
+	void removeTag(ComponentID mTag);
 
 	// Used during tests if component already exists
 	template <typename T> bool hasComponent() const
 	{
 		return componentBitSet[getComponentTypeID<T>()];
 	}
+	bool hasComponent(ComponentID id) const
+	{
+		return componentBitSet[id];
+	}
 
+	// defined below the Manager, which owns the archetype the component is built in
 	template <typename T, typename... TArgs>
-	T& addComponent(TArgs&&...mArgs)
-	{
-		T* c(new T(std::forward<TArgs>(mArgs)...));
-		c->entity = this;
-		std::unique_ptr<Component> uPtr{ c };
-		components.emplace_back(std::move(uPtr));
+	T& addComponent(TArgs&&...mArgs);
 
-		/* When we get a specific kind of component c, it will
-		always have the same position in the component array,
-		based on its componentTypeID:
-		*/
-		componentArray[getComponentTypeID<T>()] = c;
-		componentBitSet[getComponentTypeID<T>()] = true;
-
-		c->init();
-		return *c;
-	}
+	/*
+	Stamps our T with the Manager's current change tick, so that changed<T>()
+	filters pick it up. Whoever changes a component in a way others depend on
+	calls it, eg. TransformComponent::update() once the position has moved.
+	*/
+	template <typename T> void markChanged();
+	// the change tick at which our component id was added or last markChanged(); 0 if we don't have one
+	std::uint32_t getChangeTick(ComponentID id) const;
 
 	template<typename T> T& getComponent() const
 	{
+		static_assert(!IsTag<T>::value, "tags have no data; use hasTag<T>()");
 		auto ptr(componentArray[getComponentTypeID<T>()]);
 		return *static_cast<T*>(ptr);
 	}
 };
 
+/*
+Narrows View::each() or a ComponentSystem down to the entities where any of
+the given components was added or markChanged() at or after tick since,
+eg. changed<TransformComponent>(lastTick). Keep Manager::getChangeTick() from
+the last time around to pass in as since. A component the entity doesn't
+have never counts as changed.
+*/
+struct ChangedFilter
+{
+	ComponentBitSet components;
+	std::uint32_t since;
+
+	bool matches(const Entity& mEntity) const
+	{
+		for (ComponentID id = 0; id < TypeListSize<ComponentList>::value; id++)
+		{
+			if (components[id] && mEntity.hasComponent(id) && mEntity.getChangeTick(id) >= since) return true;
+		}
+		return false;
+	}
+};
+
+template <typename... Ts> ChangedFilter changed(std::uint32_t since)
+{
+	return ChangedFilter{ getComponentSignature<Ts...>(), since };
+}
+
+// +---------------------+
+// | $$$ SYSTEM CLASS $$$|
+// +---------------------+
+
+/*
+A system is one piece of per-frame logic. Manager::update() runs the
+registered systems in order instead of asking every entity to update every
+one of its components, so a component type without a system costs nothing
+per frame (eg. TileComponent, whose update() is the empty base method).
+
+Each system declares which component types it reads and which it writes.
+Manager::update() packs systems that don't get in each other's way into
+stages and runs the systems of a stage at the same time on its ThreadPool.
+A system that touches anything else shared (the command buffer, the
+renderer, ...) must say exclusive: it then runs alone on the main thread.
+*/
+class System
+{
+public:
+	ComponentBitSet reads;  // component types this system only looks at
+	ComponentBitSet writes; // component types this system changes
+	bool exclusive = false;
+
+	virtual ~System() {}
+	virtual void update(Manager& manager) = 0;
+
+	/*
+	About how many entities the next update() will go through. The Manager
+	adds these up to decide whether a stage is worth spreading over threads;
+	a system that can't tell keeps the default, which always is.
+	*/
+	virtual std::size_t workload(Manager&) { return std::numeric_limits<std::size_t>::max(); }
+
+	// true if the two must not run at the same time
+	bool conflictsWith(const System& other) const
+	{
+		return exclusive || other.exclusive ||
+			writes.intersects(other.reads | other.writes) ||
+			other.writes.intersects(reads);
+	}
+};
+
+/*
+The system for a component type whose logic lives in its own update():
+one pass down the T column of every archetype holding a T, calling
+T::update() directly. The call is not virtual, so the compiler can inline it
+into the loop. Sleeping entities are left out by the query, so they cost
+nothing. It always writes T; pass whatever else T::update() reads or writes
+through its siblings.
+
+When there are more than chunkSize Ts awake, the archetype chunks are handed
+out in runs of about chunkSize rows that go in parallel, unless the system is
+exclusive. Declaring a T as exclusive is also how to say that T::update() is
+not safe to run on several components at once.
+
+If T::update() only has work to do when some components changed (eg. a
+collider following its transform), name them in mChanged: a T is then only
+updated when one of those was added or markChanged() since the system last
+ran. Changes are judged at frame granularity, so a T can be updated once more
+than strictly needed, but never once less.
+*/
+template <typename T>
+class ComponentSystem : public System
+{
+public:
+	static constexpr std::size_t chunkSize = 1024;
+
+	ComponentSystem(ComponentBitSet mReads = ComponentBitSet(), ComponentBitSet mWrites = ComponentBitSet(),
+		bool mExclusive = false, ComponentBitSet mChanged = ComponentBitSet())
+	{
+		reads = mReads | mChanged;
+		writes = mWrites;
+		writes[getComponentTypeID<T>()] = true;
+		exclusive = mExclusive;
+		changedFilter = mChanged;
+	}
+
+	void update(Manager& manager) override;
+	// the Ts awake
+	std::size_t workload(Manager& manager) override;
+
+private:
+	// every (archetype, chunk) to go through this frame, kept for its capacity
+	std::vector<std::pair<Archetype*, std::size_t>> work;
+	ComponentBitSet changedFilter;
+	std::uint32_t lastRun = 0; // the change tick this system last ran at
+
+	// filter is nullptr when every row is to be updated
+	static void updateChunk(Archetype& a, std::size_t c, const ChangedFilter* filter)
+	{
+		T* column = a.column<T>(c);
+		Entity* const* entities = a.entities(c);
+		std::size_t rows = a.chunkRows(c);
+		for (std::size_t r = 0; r < rows; r++)
+		{
+			if (!filter || filter->matches(*entities[r])) column[r].T::update();
+		}
+	}
+};
+
+// +-----------------------------+
+// | $$$ COMMAND BUFFER CLASS $$$|
+// +-----------------------------+
+
+/*
+Records entity creation, addComponent, addTag and destroy so they can be
+applied later, in one batch, at a point where nobody is iterating: the Manager
+flushes its buffer at the start of every refresh(). Use it for anything that
+happens in the middle of an update or a loop over a query/view, eg. a
+KeyboardController firing a projectile.
+
+	auto bullet(commands.createEntity());
+	commands.addComponent<TransformComponent>(bullet, x, y);
+	commands.run(bullet, [](Entity& e) { ... any other setup ... });
+
+Component arguments are copied when recorded. Commands run in the order they
+were recorded; destroys run last. Because the whole batch is known up front,
+the flush makes room for its entities, and in their archetypes for the
+instantiate()d ones, once before building anything.
+Commands aimed at an EntityHandle whose entity is gone by then are skipped.
+
+Every thread of the Manager's ThreadPool records into a buffer of its own
+(Manager::getCommands() picks it), so systems and other work running on the
+workers can create entities without taking a lock. Each buffer notes which
+task (see ThreadPool::currentTask()) recorded what, and the flush merges all
+of them in task order rather than thread order: the entities come out in the
+same order, and into the same slots, however the work was spread over the
+threads, and however many threads there were. Every job handed to
+Manager::submit() records into a buffer of its own too, but see there for
+when those are applied.
+*/
+class CommandBuffer
+{
+public:
+	// an entity createEntity() promised; it exists once the buffer is flushed
+	struct PendingEntity
+	{
+		std::size_t index;
+	};
+
+	PendingEntity createEntity()
+	{
+		mark();
+		return PendingEntity{ creates++ };
+	}
+
+	template <typename T, typename... TArgs>
+	void addComponent(PendingEntity mEntity, TArgs&&... mArgs)
+	{
+		mark();
+		Command command(makeAddComponent<T>(std::forward<TArgs>(mArgs)...));
+		command.pending = mEntity.index;
+		commands.emplace_back(std::move(command));
+	}
+
+	template <typename T, typename... TArgs>
+	void addComponent(EntityHandle mEntity, TArgs&&... mArgs)
+	{
+		mark();
+		Command command(makeAddComponent<T>(std::forward<TArgs>(mArgs)...));
+		command.handle = mEntity;
+		commands.emplace_back(std::move(command));
+	}
+
+	template <typename T>
+	void addTag(PendingEntity mEntity)
+	{
+		run(mEntity, [](Entity& e) { e.addTag<T>(); });
+	}
+
+	template <typename T>
+	void addTag(EntityHandle mEntity)
+	{
+		run(mEntity, [](Entity& e) { e.addTag<T>(); });
+	}
+
+	template <typename T>
+	void removeTag(EntityHandle mEntity)
+	{
+		run(mEntity, [](Entity& e) { e.removeTag<T>(); });
+	}
+
+	// calls f(Entity&) on the entity during the flush, after the commands recorded before it
+	template <typename F>
+	void run(PendingEntity mEntity, F f)
+	{
+		mark();
+		Command command;
+		command.pending = mEntity.index;
+		command.apply = f;
+		commands.emplace_back(std::move(command));
+	}
+
+	template <typename F>
+	void run(EntityHandle mEntity, F f)
+	{
+		mark();
+		Command command;
+		command.handle = mEntity;
+		command.apply = f;
+		commands.emplace_back(std::move(command));
+	}
+
+	/*
+	An entity stamped out of mPrefab at the flush, see Prefab::instantiate().
+	The prefab must still be alive then.
+	*/
+	template <typename F>
+	PendingEntity instantiate(const Prefab& mPrefab, F customize);
+
+	void destroy(EntityHandle mEntity)
+	{
+		mark();
+		destroys.push_back(mEntity);
+	}
+
+	bool empty() const { return creates == 0 && commands.empty() && destroys.empty(); }
+
+	// applies and clears everything recorded so far in mBuffers, one buffer per thread
+	static void flush(Manager& mManager, const std::vector<std::unique_ptr<CommandBuffer>>& mBuffers);
+
+private:
+	static constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+	struct Command
+	{
+		std::size_t pending = none; // a createEntity() of this buffer, or none to use handle
+		EntityHandle handle;
+		const Prefab* prefab = nullptr; // an instantiate(): the flush makes room in its archetype
+		std::function<void(Entity&)> apply;
+	};
+
+	// what one task recorded: everything from these positions up to the next segment
+	struct Segment
+	{
+		ThreadPool::TaskKey task;
+		std::size_t creates;
+		std::size_t commands;
+		std::size_t destroys;
+	};
+
+	std::size_t creates = 0;
+	std::vector<Command> commands;
+	std::vector<EntityHandle> destroys;
+	std::vector<Segment> segments;
+	std::uint64_t taskVersion = 0; // ThreadPool::taskVersion() when the last segment began
+
+	// what flush() works on, kept around so their capacity is reused every frame
+	std::vector<Command> flushCommands;
+	std::vector<EntityHandle> flushDestroys;
+	std::vector<Segment> flushSegments;
+	std::vector<Entity*> created;
+
+	// starts a new segment if the recording thread has moved on to another task
+	void mark()
+	{
+		if (taskVersion == ThreadPool::taskVersion()) return;
+		taskVersion = ThreadPool::taskVersion();
+		segments.push_back(Segment{ ThreadPool::currentTask(), creates, commands.size(), destroys.size() });
+	}
+
+	// where flushed segment s ends
+	Segment segmentEnd(std::size_t s) const
+	{
+		if (s + 1 < flushSegments.size()) return flushSegments[s + 1];
+		return Segment{ ThreadPool::TaskKey(), created.size(), flushCommands.size(), flushDestroys.size() };
+	}
+
+	template <typename T, typename Tuple, std::size_t... Is>
+	static void addFromTuple(Entity& mEntity, Tuple& mArgs, std::index_sequence<Is...>);
+
+	template <typename T, typename... TArgs>
+	static Command makeAddComponent(TArgs&&... mArgs)
+	{
+		Command command;
+		auto args(std::make_tuple(std::forward<TArgs>(mArgs)...));
+		command.apply = [args](Entity& e) mutable
+		{
+			addFromTuple<T>(e, args, std::index_sequence_for<TArgs...>());
+		};
+		return command;
+	}
+};
+
 // +----------------------+
 // | $$$ MANAGER CLASS $$$|
 // +----------------------+
@@ -144,57 +861,730 @@ public:
 class Manager
 {
 private:
-	std::vector<std::unique_ptr<Entity>> entities;
-	std::array<std::vector<Entity*>, maxGroups> groupedEntities;
+	// indexed by ComponentID; see registerComponent()
+	std::array<const ComponentStorage*, firstTagID> storage{};
+	// ~Manager() destroys the entities before these: ~Entity() destroys its components, which live in the chunks
+	std::vector<std::unique_ptr<Archetype>> archetypes;
+	std::unordered_map<ComponentBitSet, Archetype*> archetypeIndex;
+
+	struct QueryKey
+	{
+		ComponentBitSet required;
+		ComponentBitSet excluded;
+		bool operator==(const QueryKey& other) const
+		{
+			return required == other.required && excluded == other.excluded;
+		}
+	};
+	struct QueryKeyHash
+	{
+		std::size_t operator()(const QueryKey& key) const
+		{
+			std::hash<ComponentBitSet> hash;
+			return hash(key.required) * 31 ^ hash(key.excluded);
+		}
+	};
+	std::unordered_map<QueryKey, std::unique_ptr<Query>, QueryKeyHash> queries;
+	// systems running side by side may ask for their queries at the same time
+	std::mutex queryMutex;
+	/*
+	One slot per entity, indexed by EntityHandle::index, built in place inside
+	fixed-size pages: pages never move, so Entity& stays valid for the life of
+	the slot, and reserveEntities() can allocate room for a whole map in one go.
+	Dead slots are not erased; they go on freeEntities and get reused.
+	*/
+	static constexpr std::size_t entityPageSize = 256;
+	using EntityStorage = std::aligned_storage<sizeof(Entity), alignof(Entity)>::type;
+	std::vector<std::unique_ptr<EntityStorage[]>> entityPages;
+	std::size_t entityCount = 0;
+	std::vector<std::uint32_t> freeEntities;
+	// compact() has sorted freeEntities, and refresh() hasn't added to it since
+	bool freeEntitiesSorted = true;
+
+	Entity& entityAt(std::size_t i)
+	{
+		return *reinterpret_cast<Entity*>(&entityPages[i / entityPageSize][i % entityPageSize]);
+	}
+	const Entity& entityAt(std::size_t i) const
+	{
+		return *reinterpret_cast<const Entity*>(&entityPages[i / entityPageSize][i % entityPageSize]);
+	}
+
+	// entities that were destroyed since the last refresh()
+	std::vector<Entity*> dirtyEntities;
+	// one per thread that can record, indexed by ThreadPool::threadIndex()
+	std::vector<std::unique_ptr<CommandBuffer>> commandBuffers;
+	// what submit()ted jobs recorded, by the order they were submitted in; see refresh()
+	std::mutex jobMutex;
+	std::vector<std::pair<std::uint64_t, std::unique_ptr<CommandBuffer>>> finishedJobs;
+	std::vector<std::unique_ptr<CommandBuffer>> spareJobCommands;
+	std::uint64_t jobsSubmitted = 0;
+	std::uint64_t jobsApplied = 0;
+	// set on a thread while it runs a submit()ted job: the job's buffer, and whose job it is
+	static thread_local CommandBuffer* jobCommands;
+	static thread_local const Manager* jobManager;
+	// the thread that made the Manager; the one getCommands() hands commandBuffers[0] to
+	std::thread::id owner;
+	std::vector<std::unique_ptr<System>> systems;
+	// systems grouped into stages that may run in parallel, rebuilt when a system is added
+	std::vector<std::vector<System*>> stages;
+	std::unique_ptr<ThreadPool> threadPool;
+	std::size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	// destroy() may be called from systems running on worker threads
+	std::mutex dirtyMutex;
+	std::uint32_t changeTick = 1;
+	// indexed by getEventTypeID<E>(); a slot stays empty until that queue is asked for
+	std::array<std::unique_ptr<BaseEventQueue>, eventTypeCount> eventQueues;
+	std::mutex eventMutex;
+
+	void buildStages();
+	// points mEntity at its components again after its row moved, and has them relink()
+	void relocate(Entity& mEntity);
+	// removes row from mArchetype and relocates whatever moved into it
+	void dropRow(Archetype& mArchetype, std::size_t row);
 public:
-	
-	void update()
+	Manager() : owner(std::this_thread::get_id())
+	{
+		commandBuffers.emplace_back(new CommandBuffer());
+	}
+	Manager(const Manager&) = delete;
+	Manager& operator=(const Manager&) = delete;
+	~Manager();
+
+	/*
+	Runs every system. A system never starts before the systems added ahead of
+	it that it conflicts with have finished; systems that don't conflict may
+	run at the same time, unless between them they have fewer than
+	serialStageWorkload entities to go through (see System::workload()): then
+	handing them to the workers costs more than it saves, and they run one
+	after the other on the calling thread.
+	*/
+	void update();
+	static constexpr std::size_t serialStageWorkload = 1024;
+
+	/*
+	Goes up by one at the start of every update(). Components added or
+	markChanged() are stamped with it; see ChangedFilter.
+	*/
+	std::uint32_t getChangeTick() const { return changeTick; }
+
+	template <typename T, typename... TArgs>
+	T& addSystem(TArgs&&... mArgs)
 	{
-		for (auto& e : entities) e->update();
+		T* s(new T(std::forward<TArgs>(mArgs)...));
+		systems.emplace_back(s);
+		stages.clear();
+		return *s;
+	}
+
+	// the workers systems run on, started the first time it is asked for
+	ThreadPool& getThreadPool()
+	{
+		if (!threadPool)
+		{
+			threadPool.reset(new ThreadPool(threadCount - 1));
+			while (commandBuffers.size() < threadPool->size()) commandBuffers.emplace_back(new CommandBuffer());
+		}
+		return *threadPool;
+	}
+
+	/*
+	Runs mJob(commands) on one of the workers, without waiting for it, for
+	work like building a level in the background. What the job records in
+	commands (or in getCommands(), which is the same buffer while the job
+	runs) is applied by the first refresh() after it finishes. Jobs are
+	applied in the order they were submitted, a job that finishes early
+	waiting for the ones before it, so one job's entities never land among
+	another's. Which refresh() that is depends on how long the jobs take,
+	though, so what else was created before them, and so the slots their
+	entities get, can differ from run to run. Submit from the thread that
+	made the Manager. A job must leave the entities alone, since systems may be
+	running, and must not call update() or ThreadPool::run().
+	*/
+	void submit(std::function<void(CommandBuffer&)> mJob);
+
+	// jobs submit()ted whose commands refresh() hasn't applied yet
+	std::size_t pendingJobs()
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		return static_cast<std::size_t>(jobsSubmitted - jobsApplied);
+	}
+
+	// how many threads update() may use, counting the main thread (1 = no workers); waits for running jobs
+	void setThreadCount(std::size_t n)
+	{
+		threadCount = std::max<std::size_t>(n, 1);
+		threadPool.reset();
 	}
 	void draw()
 	{
-		for (auto& e : entities) e->draw();
+		for (std::size_t i = 0; i < entityCount; i++)
+		{
+			if (entityAt(i).isActive()) entityAt(i).draw();
+		}
+	}
+
+	/*
+	First applies the command buffer, then
+	only looks at the entities destroy() queued since last time,
+	so a frame where nothing died costs nothing here.
+	*/
+	void refresh();
+
+	/*
+	Tidies up after a wave of deaths. The components need no help: archetype
+	rows never have holes (see Archetype). What is left is freeing the chunks
+	nobody uses any more and having the next addEntity()s reuse the lowest
+	entity slots first, so new entities fill in from the front rather than
+	wherever the last ones died. It costs a glance at each archetype, so it
+	can be called every frame. Like refresh(), call it between updates, never
+	while anything is iterating.
+	*/
+	void compact();
+
+	void markDirty(Entity& mEntity)
+	{
+		std::lock_guard<std::mutex> lock(dirtyMutex);
+		if (!mEntity.dirty)
+		{
+			mEntity.dirty = true;
+			dirtyEntities.push_back(&mEntity);
+		}
+	}
+
+	/*
+	For creating/destroying entities while something is being iterated; applied
+	by refresh(). The calling thread's own buffer: the main thread's, or on one
+	of the ThreadPool's workers, that worker's, or in a submit()ted job, the
+	job's. Any other thread has to go through submit().
+	*/
+	CommandBuffer& getCommands()
+	{
+		if (jobManager == this) return *jobCommands;
+		std::size_t thread = ThreadPool::threadIndex();
+		assert((thread != 0 || std::this_thread::get_id() == owner) && "getCommands() from a thread the Manager doesn't know; use submit()");
+		return *commandBuffers[thread];
+	}
+
+	// The queue for events of type E. Created the first time it is asked for.
+	template <typename E> EventQueue<E>& getEvents()
+	{
+		std::lock_guard<std::mutex> lock(eventMutex);
+		constexpr EventTypeID id = getEventTypeID<E>();
+		if (!eventQueues[id]) eventQueues[id].reset(new EventQueue<E>());
+		return *static_cast<EventQueue<E>*>(eventQueues[id].get());
+	}
+
+	// nullptr if nothing has asked for the queue yet, so nobody can be listening
+	template <typename E> EventQueue<E>* findEvents()
+	{
+		std::lock_guard<std::mutex> lock(eventMutex);
+		constexpr EventTypeID id = getEventTypeID<E>();
+		return static_cast<EventQueue<E>*>(eventQueues[id].get());
+	}
+
+	/*
+	Hands every queue's events to its handlers, once a frame at a point of the
+	game's choosing. Keeps going until handlers stop emitting new ones, so
+	every queue is empty when it returns.
+	*/
+	void dispatchEvents();
+
+	Entity& addEntity()
+	{
+		if (!freeEntities.empty())
+		{
+			Entity& e(entityAt(freeEntities.back()));
+			freeEntities.pop_back();
+			e.revive();
+			return e;
+		}
+
+		if (entityCount == entityPages.size() * entityPageSize)
+		{
+			entityPages.emplace_back(new EntityStorage[entityPageSize]);
+		}
+		std::size_t i = entityCount++;
+		// recieves reference to the manager object that gets created in the Game class
+		return *new (&entityPages[i / entityPageSize][i % entityPageSize])
+			Entity(*this, EntityHandle{ static_cast<std::uint32_t>(i), 0u });
+	}
+
+	// makes sure n more addEntity() calls won't allocate
+	void reserveEntities(std::size_t n)
+	{
+		std::size_t needed = entityCount + n - std::min(n, freeEntities.size());
+		while (entityPages.size() * entityPageSize < needed)
+		{
+			entityPages.emplace_back(new EntityStorage[entityPageSize]);
+		}
 	}
 
-	void refresh()
+	/*
+	n new entities in one go, for loading maps and the like. Every entity gets
+	the tags in mTags and build(Entity&, std::size_t i) adds its components.
+	The tags go on first, so the entity only lands in an archetype once it
+	has its components; mTags may include sleepingSignature to have them
+	asleep from the start too. The entity slots, and the rows of the archetype
+	mTags and Ts make, are sized once up front, eg.
+		addEntities<TileComponent>(width * height, getComponentSignature<MapTag>() | sleepingSignature, f)
+	*/
+	template <typename... Ts, typename F>
+	void addEntities(std::size_t n, const ComponentBitSet& mTags, F build)
 	{
-		for (auto i(0u); i < maxGroups; i++)
+		reserveEntities(n);
+		int registered[] = { 0, (registerComponent<Ts>(), 0)... };
+		(void)registered;
+		ComponentBitSet tags(mTags);
+		tags[sleepingFlag] = false;
+		if ((tags | getComponentSignature<Ts...>()).any()) getArchetype(mTags | getComponentSignature<Ts...>()).reserve(n);
+
+		for (std::size_t i = 0; i < n; i++)
 		{
-			auto& v(groupedEntities[i]);
-			// erase() has only 2 arguments:
-			v.erase(
-				std::remove_if(std::begin(v), std::end(v), [i](Entity* mEntity)
+			Entity& e(addEntity());
+			e.componentBitSet |= tags;
+			e.sleeping = mTags[sleepingFlag];
+			build(e, i);
+			// tags only, no components: nothing has put it in its archetype yet
+			if (!e.archetype) updateArchetype(e);
+		}
+	}
+
+	// true while the entity the handle was taken from still owns its slot
+	bool isValid(EntityHandle mHandle) const
+	{
+		return mHandle.index < entityCount &&
+			entityAt(mHandle.index).handle.generation == mHandle.generation;
+	}
+
+	// nullptr if the entity behind the handle has been destroyed and cleaned up
+	Entity* getEntity(EntityHandle mHandle)
+	{
+		return isValid(mHandle) ? &entityAt(mHandle.index) : nullptr;
+	}
+
+	/*
+	Tells the Manager how to keep Ts in the archetypes' chunks, which it has
+	to know before the first archetype with a T is made. addComponent(),
+	addEntities() and Prefab see to it, so there is no need to call it.
+	*/
+	template <typename T> void registerComponent()
+	{
+		registerComponent(getComponentTypeID<T>(), componentStorage<T>);
+	}
+	void registerComponent(ComponentID id, const ComponentStorage& mStorage)
+	{
+		storage[id] = &mStorage;
+	}
+
+	// The archetype for exactly this signature. Created the first time it is asked for.
+	Archetype& getArchetype(const ComponentBitSet& mSignature);
+
+	/*
+	Moving an entity to another archetype goes in two steps, so that the
+	components it gains can be built straight into the new row while the old
+	one is still there. openRow() adds a row for mEntity to the archetype its
+	signature now picks and returns that archetype, or nullptr if mEntity is
+	in it already. closeRow() then moves over the components mEntity keeps,
+	drops its old row and relinks whatever moved. Whatever mEntity loses must
+	be destroyed before.
+	*/
+	Archetype* openRow(Entity& mEntity, std::size_t& mRow);
+	void closeRow(Entity& mEntity, Archetype& mTo, std::size_t mRow);
+	// both at once, for a change that gains no component, like a tag or sleep()
+	void updateArchetype(Entity& mEntity);
+	// destroys mEntity's components and drops its row
+	void leaveArchetype(Entity& mEntity);
+
+	const std::vector<std::unique_ptr<Archetype>>& getArchetypes() const { return archetypes; }
+
+	/*
+	The cached query for these signatures, created (and filled with the matching
+	archetypes) the first time it is asked for. Cheap enough to call every frame,
+	but it can also be kept: the reference stays valid for the Manager's lifetime.
+	*/
+	Query& getQuery(const ComponentBitSet& mRequired, const ComponentBitSet& mExcluded = ComponentBitSet());
+
+	/*
+	Every entity that has all of Ts, plus everything in mWith and nothing in mWithout,
+	eg. view<TransformComponent, ColliderComponent>(with<MonsterTag>())
+	*/
+	template <typename... Ts> View<Ts...> view(With mWith = With(), Without mWithout = Without());
+	template <typename... Ts> View<Ts...> view(Without mWithout)
+	{
+		return view<Ts...>(With(), mWithout);
+	}
+};
+
+template <typename T, typename... TArgs>
+T& Entity::addComponent(TArgs&&...mArgs)
+{
+	static_assert(!IsTag<T>::value, "tags have no data; use addTag<T>()");
+	ComponentID id = getComponentTypeID<T>();
+	manager.registerComponent<T>();
+
+	T* c;
+	if (componentBitSet[id])
+	{
+		// only one component of each type per entity: the new one takes the old one's place
+		void* slot = archetype->slot(archetypeRow, id);
+		componentArray[id]->~Component();
+		c = new (slot) T(std::forward<TArgs>(mArgs)...);
+		c->entity = this;
+		componentArray[id] = c;
+		components.erase(std::find(components.begin(), components.end(), id));
+	}
+	else
+	{
+		componentBitSet[id] = true;
+		std::size_t row;
+		Archetype* to = manager.openRow(*this, row);
+		// built before the others move, so mArgs may still refer to them
+		c = new (to->slot(row, id)) T(std::forward<TArgs>(mArgs)...);
+		c->entity = this;
+		// before closeRow() has the others relink(), since they may look it up
+		componentArray[id] = c;
+		manager.closeRow(*this, *to, row);
+	}
+
+	components.push_back(id);
+	archetype->setChangeTick(archetypeRow, id, manager.getChangeTick());
+
+	c->init();
+	// init() may have added a component, which moves us
+	return getComponent<T>();
+}
+
+template <typename T>
+void Entity::markChanged()
+{
+	ComponentID id = getComponentTypeID<T>();
+	if (!componentBitSet[id]) return;
+	archetype->setChangeTick(archetypeRow, id, manager.getChangeTick());
+}
+
+// +---------------------+
+// | $$$ PREFAB CLASS $$$|
+// +---------------------+
+
+/*
+A prefab describes an entity once: its components, built up front with their
+defaults (textures looked up, animations filled in, ...), and its tags.
+instantiate() then copies those prepared components straight into the new
+entity's row of the archetype they make, instead of running every
+constructor again and moving the entity from archetype to archetype once per
+component, and init()s them when they are all there. Asking for N at a time
+also sizes that archetype, and the entity slots, once; so does a batch of
+CommandBuffer::instantiate()s.
+
+	Prefab spider;
+	spider.addComponent<TransformComponent>(0, 0, 64, 64, 1);
+	spider.addComponent<SpriteComponent>("monster", true);
+	spider.addTag<MonsterTag>();
+
+	spider.instantiate(manager, 500, [](Entity& e, std::size_t i)
+	{
+		e.getComponent<TransformComponent>().position.x = 64.0f * i;
+	});
+
+The customize function sees the copied components before their init() runs,
+so whatever init() derives from them (eg. a collider's destRect) picks up
+the per-instance values.
+*/
+class Prefab
+{
+public:
+	Prefab() = default;
+	Prefab(Prefab&&) = default;
+	Prefab& operator=(Prefab&&) = default;
+
+	// the prototype every instance gets a copy of; adding a type twice replaces it
+	template <typename T, typename... TArgs>
+	T& addComponent(TArgs&&... mArgs)
+	{
+		T* c(new T(std::forward<TArgs>(mArgs)...));
+		c->entity = nullptr;
+		Part part{ getComponentTypeID<T>(), std::unique_ptr<Component>(c), &componentStorage<T> };
+		signature[part.id] = true;
+
+		for (auto& p : parts)
+		{
+			if (p.id == part.id)
 			{
-				return !mEntity->isActive() || !mEntity->hasGroup(i);
+				p = std::move(part);
+				return *c;
 			}
-			),
-				std::end(v));
 		}
+		parts.emplace_back(std::move(part));
+		return *c;
+	}
+
+	template <typename T>
+	void addTag()
+	{
+		static_assert(IsTag<T>::value, "addTag<T>() takes a type from TagList in ECS/ComponentList.h");
+		signature[getComponentTypeID<T>()] = true;
+	}
+
+	Entity& instantiate(Manager& mManager)
+	{
+		return instantiate(mManager, [](Entity&) {});
+	}
+
+	// customize(Entity&) runs before the components' init()
+	template <typename F>
+	Entity& instantiate(Manager& mManager, F customize)
+	{
+		Entity& e(mManager.addEntity());
+		stamp(e, customize);
+		return e;
+	}
 
-		entities.erase(std::remove_if(std::begin(entities),
-			std::end(entities), [](const std::unique_ptr<Entity> &mEntity)
+	// n entities at once; customize(Entity&, std::size_t i) runs before the components' init()
+	template <typename F>
+	void instantiate(Manager& mManager, std::size_t n, F customize)
+	{
+		reserve(mManager, n);
+		for (std::size_t i = 0; i < n; i++)
 		{
-			return !mEntity->isActive();
-		}),
-			std::end(entities));
+			stamp(mManager.addEntity(), [&customize, i](Entity& e) { customize(e, i); });
+		}
 	}
 
-	void addToGroup(Entity* mEntity, Group mGroup)
+	// makes room for n more instances: n entities, and n more rows in the archetype they go into
+	void reserve(Manager& mManager, std::size_t n) const
 	{
-		groupedEntities[mGroup].emplace_back(mEntity); //append Entity to the end of group
+		mManager.reserveEntities(n);
+		reserveRows(mManager, n);
 	}
 
-	std::vector<Entity*>& getGroup(Group mGroup)
+	// gives mEntity (fresh from Manager::addEntity()) a copy of everything in the prefab
+	template <typename F>
+	void stamp(Entity& mEntity, F customize) const
 	{
-		return groupedEntities[mGroup];
+		place(mEntity);
+		customize(mEntity);
+		mEntity.initComponents();
 	}
 
-	Entity& addEntity()
+private:
+	// sizes the archetypes for the instantiate()s recorded in a batch
+	friend class CommandBuffer;
+
+	struct Part
+	{
+		ComponentID id;
+		std::unique_ptr<Component> prototype;
+		const ComponentStorage* storage;
+	};
+	std::vector<Part> parts;
+	ComponentBitSet signature; // the parts and the tags
+
+	void registerParts(Manager& mManager) const;
+	void reserveRows(Manager& mManager, std::size_t n) const;
+	// puts mEntity in its archetype with copies of the prototypes, not init()ed yet
+	void place(Entity& mEntity) const;
+};
+
+template <typename F>
+CommandBuffer::PendingEntity CommandBuffer::instantiate(const Prefab& mPrefab, F customize)
+{
+	PendingEntity e(createEntity());
+	run(e, [&mPrefab, customize](Entity& entity) { mPrefab.stamp(entity, customize); });
+	commands.back().prefab = &mPrefab;
+	return e;
+}
+
+// +-------------------+
+// | $$$ VIEW CLASS $$$|
+// +-------------------+
+
+/*
+A view walks every entity that has all of the components Ts..., straight off
+the archetype chunks of its cached Query: nothing has to be registered for it,
+and each component is fetched once per entity from a column instead of through
+getComponent(). Ts are components with data; tags and other extra conditions
+go in with<...>() and without<...>().
+
+	for (auto c : manager.view<TransformComponent, ColliderComponent>())
 	{
-		Entity* e = new Entity(*this); // recieves reference to the manager object that gets created in the Game class
-		std::unique_ptr<Entity> uPtr{ e };
-		entities.emplace_back(std::move(uPtr));
-		return *e;
+		TransformComponent& transform = std::get<0>(c);
+		...
 	}
-};
\ No newline at end of file
+
+or, without the std::get<>,
+
+	manager.view<TransformComponent, ColliderComponent>().each(
+		[](TransformComponent& transform, ColliderComponent& collider) { ... });
+
+Every component has an entity pointer for when the Entity itself is needed.
+Destroyed entities are still visited until the next Manager::refresh().
+Adding or removing components or tags while a view is being walked moves
+rows between archetypes, so don't.
+*/
+template <typename... Ts>
+class View
+{
+public:
+	static_assert(!AnyTag<Ts...>::value, "tags have no data to view; ask for them with with<T>()");
+
+	View(Manager& mManager, With mWith = With(), Without mWithout = Without())
+		: query(mManager.getQuery(getComponentSignature<Ts...>() | mWith.signature, mWithout.signature)) {}
+
+	class iterator
+	{
+	public:
+		iterator(const Query* mQuery, std::size_t mArchetype) : query(mQuery), archetype(mArchetype)
+		{
+			settle();
+		}
+
+		std::tuple<Ts&...> operator*() const
+		{
+			return fetch(std::index_sequence_for<Ts...>());
+		}
+
+		iterator& operator++()
+		{
+			if (++row == rows)
+			{
+				row = 0;
+				chunk++;
+				settle();
+			}
+			return *this;
+		}
+
+		bool operator==(const iterator& other) const
+		{
+			return archetype == other.archetype && chunk == other.chunk && row == other.row;
+		}
+		bool operator!=(const iterator& other) const { return !(*this == other); }
+
+	private:
+		const Query* query;
+		std::size_t archetype;
+		std::size_t chunk = 0;
+		std::size_t row = 0;
+		std::size_t rows = 0;
+		std::tuple<Ts*...> columns;
+
+		// moves forward to the first chunk, at or after the current one, that has rows for us
+		void settle()
+		{
+			auto& archetypes(query->getArchetypes());
+			for (; archetype < archetypes.size(); archetype++, chunk = 0)
+			{
+				Archetype& a(*archetypes[archetype]);
+				if (chunk < a.chunkCount())
+				{
+					rows = a.chunkRows(chunk);
+					columns = std::tuple<Ts*...>(a.column<Ts>(chunk)...);
+					return;
+				}
+			}
+			chunk = 0;
+		}
+
+		template <std::size_t... Is>
+		std::tuple<Ts&...> fetch(std::index_sequence<Is...>) const
+		{
+			return std::tuple<Ts&...>(std::get<Is>(columns)[row]...);
+		}
+	};
+
+	iterator begin() const { return iterator(&query, 0); }
+	iterator end() const { return iterator(&query, query.getArchetypes().size()); }
+
+	// calls f(Ts&...) for every entity in the view
+	template <typename F>
+	void each(F f) const
+	{
+		each(f, std::index_sequence_for<Ts...>());
+	}
+
+	// the same, for the entities that pass mFilter, eg. each(changed<TransformComponent>(tick), f)
+	template <typename F>
+	void each(const ChangedFilter& mFilter, F f) const
+	{
+		each([&mFilter, &f](Ts&... c)
+		{
+			if (mFilter.matches(*std::get<0>(std::tie(c...)).entity)) f(c...);
+		});
+	}
+
+	std::size_t size() const { return query.size(); }
+
+private:
+	const Query& query;
+
+	template <typename F, std::size_t... Is>
+	void each(F& f, std::index_sequence<Is...>) const
+	{
+		auto& archetypes(query.getArchetypes());
+		for (std::size_t i = 0; i < archetypes.size(); i++)
+		{
+			Archetype& a(*archetypes[i]);
+			for (std::size_t c = 0; c < a.chunkCount(); c++)
+			{
+				std::size_t rows = a.chunkRows(c);
+				std::tuple<Ts*...> columns(a.column<Ts>(c)...);
+				for (std::size_t r = 0; r < rows; r++)
+				{
+					f(std::get<Is>(columns)[r]...);
+				}
+			}
+		}
+	}
+};
+
+template <typename... Ts>
+View<Ts...> Manager::view(With mWith, Without mWithout)
+{
+	return View<Ts...>(*this, mWith, mWithout);
+}
+
+template <typename T>
+constexpr std::size_t ComponentSystem<T>::chunkSize;
+
+template <typename T>
+void ComponentSystem<T>::update(Manager& manager)
+{
+	Query& awake(manager.getQuery(getComponentSignature<T>(), sleepingSignature));
+
+	work.clear();
+	for (Archetype* a : awake.getArchetypes())
+	{
+		for (std::size_t c = 0; c < a->chunkCount(); c++) work.emplace_back(a, c);
+	}
+
+	ChangedFilter changes{ changedFilter, lastRun };
+	const ChangedFilter* filter = changedFilter.any() ? &changes : nullptr;
+	lastRun = manager.getChangeTick();
+
+	if (exclusive || awake.size() <= chunkSize)
+	{
+		for (auto& w : work) updateChunk(*w.first, w.second, filter);
+		return;
+	}
+
+	const std::size_t perTask = chunkSize / Archetype::chunkSize;
+	const std::vector<std::pair<Archetype*, std::size_t>>& chunks(work);
+	manager.getThreadPool().run((chunks.size() + perTask - 1) / perTask, [&chunks, perTask, filter](std::size_t task)
+	{
+		std::size_t end = std::min(chunks.size(), (task + 1) * perTask);
+		for (std::size_t i = task * perTask; i < end; i++) updateChunk(*chunks[i].first, chunks[i].second, filter);
+	});
+}
+
+template <typename T>
+std::size_t ComponentSystem<T>::workload(Manager& manager)
+{
+	return manager.getQuery(getComponentSignature<T>(), sleepingSignature).size();
+}
+
+template <typename T, typename Tuple, std::size_t... Is>
+void CommandBuffer::addFromTuple(Entity& mEntity, Tuple& mArgs, std::index_sequence<Is...>)
+{
+	mEntity.addComponent<T>(std::move(std::get<Is>(mArgs))...);
+}
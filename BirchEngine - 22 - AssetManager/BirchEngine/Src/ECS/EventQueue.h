@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <cstddef>
+#include "ComponentList.h"
+
+/*
+Event types are plain structs, registered in EventList in ComponentList.h.
+An event's ID is its position there, worked out by the compiler the same
+way a component's is.
+*/
+using EventTypeID = std::size_t;
+
+constexpr std::size_t eventTypeCount = TypeListSize<EventList>::value;
+
+template <typename E> constexpr EventTypeID getEventTypeID() noexcept
+{
+	static_assert(TypeContains<E, EventList>::value, "this event type is not registered in EventList in ECS/ComponentList.h");
+	return TypeIndex<E, EventList>::value;
+}
+
+class BaseEventQueue
+{
+public:
+	virtual ~BaseEventQueue() {}
+
+	// hands everything emitted so far to the handlers; false if there was nothing to hand out
+	virtual bool dispatch() = 0;
+};
+
+/*
+Every event of type E emitted this frame, kept in one vector. Whoever notices
+something only emit()s it; whoever reacts to it subscribe()s and is handed the
+whole batch at once when Manager::dispatchEvents() runs, so detection loops
+don't call into gameplay code and can run on any thread:
+
+	manager.getEvents<ProjectileHit>().subscribe([](const std::vector<ProjectileHit>& hits)
+	{
+		for (auto& hit : hits) ...
+	});
+*/
+template <typename E>
+class EventQueue : public BaseEventQueue
+{
+public:
+	using Handler = std::function<void(const std::vector<E>&)>;
+
+	// safe to call from systems running on worker threads
+	void emit(const E& mEvent)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		events.push_back(mEvent);
+	}
+
+	// one lock for a whole batch, eg. everything a system found in its chunk
+	void emit(const std::vector<E>& mEvents)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		events.insert(events.end(), mEvents.begin(), mEvents.end());
+	}
+
+	// handlers are called in the order they subscribed
+	void subscribe(Handler mHandler)
+	{
+		handlers.push_back(std::move(mHandler));
+	}
+
+	std::size_t size() const { return events.size(); }
+
+	/*
+	Events a handler emits while this runs, of this type or any other, are
+	not lost: they go in the next batch, which Manager::dispatchEvents() hands
+	out before it returns.
+	*/
+	bool dispatch() override
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (events.empty()) return false;
+			dispatching.swap(events);
+		}
+
+		for (auto& h : handlers) h(dispatching);
+		dispatching.clear();
+		return true;
+	}
+
+private:
+	std::vector<E> events;
+	// the batch being handed out; keeps its capacity from frame to frame
+	std::vector<E> dispatching;
+	std::vector<Handler> handlers;
+	std::mutex mutex;
+};
@@ -2,6 +2,7 @@
 #include "../Game.h"
 #include "ECS.h"
 #include "Components.h"
+#include "TransformHierarchy.h"
 
 class KeyboardController : public Component
 {
@@ -11,6 +12,17 @@ private:
 public:
 	TransformComponent *transform;
 	SpriteComponent *sprite;
+	// where projectiles come from; Game::init() attaches it to the player (see TransformHierarchy)
+	Entity* muzzle = nullptr;
+
+	// from the player's position to the end of the gun, for each way he can face
+	static Vector2D muzzleOffset(const Vector2D& mFacing)
+	{
+		if (mFacing == Vector2D(0, -1)) return Vector2D(26, 16);
+		if (mFacing == Vector2D(0, 1)) return Vector2D(5, 16);
+		if (mFacing == Vector2D(1, 0)) return Vector2D(32, 16);
+		return Vector2D(-32, 16);
+	}
 
 	void init() override
 	{
@@ -18,6 +30,12 @@ public:
 		sprite = &entity->getComponent<SpriteComponent>();
 	}
 
+	void relink() override
+	{
+		transform = &entity->getComponent<TransformComponent>();
+		sprite = &entity->getComponent<SpriteComponent>();
+	}
+
 	void update() override
 	{
 		if (Game::event.type == SDL_KEYDOWN)
@@ -27,24 +45,28 @@ public:
 			case SDLK_w:
 				transform->velocity.y = -1;
 				transform->facing = Vector2D(0, -1); // up
+				aim();
 				sprite->Play("WalkUp");
 				sprite->spriteFlip = SDL_FLIP_NONE;
 				break;
 			case SDLK_s:
 				transform->velocity.y = 1;
 				transform->facing = Vector2D(0, 1); // down
+				aim();
 				sprite->Play("WalkDown");
 				sprite->spriteFlip = SDL_FLIP_NONE;
 				break;
 			case SDLK_a:
 				transform->velocity.x = -1;
 				transform->facing = Vector2D(-1, 0); // left
+				aim();
 				sprite->Play("WalkRight");
 				sprite->spriteFlip = SDL_FLIP_HORIZONTAL;
 				break;
 			case SDLK_d:
 				transform->velocity.x = 1;
 				transform->facing = Vector2D(1, 0); // right
+				aim();
 				sprite->Play("WalkRight");
 				sprite->spriteFlip = SDL_FLIP_NONE;
 				break;
@@ -94,7 +116,7 @@ public:
 					transform->velocity.Zero();
 					sprite->Play("ShootUp");
 					sprite->spriteFlip = SDL_FLIP_NONE;
-					Game::assets->CreateProjectile(Vector2D(26, 16) + transform->position, Vector2D(0, -2), 352, 1, "projectile");
+					Game::assets->CreateProjectile(muzzlePosition(), Vector2D(0, -2), 352, 1, "projectile");
 					currentTime = SDL_GetTicks();
 					// fix repeating animation later
 				}
@@ -103,26 +125,38 @@ public:
 					transform->velocity.Zero();
 					sprite->Play("ShootDown");
 					sprite->spriteFlip = SDL_FLIP_NONE;
-					Game::assets->CreateProjectile(Vector2D(5, 16) + transform->position, Vector2D(0, 2), 352, 1, "projectile");
+					Game::assets->CreateProjectile(muzzlePosition(), Vector2D(0, 2), 352, 1, "projectile");
 					// fix repeating animation later
 				}
 				else if (transform->facing == Vector2D(1, 0))
 				{
 					transform->velocity.Zero();
 					sprite->Play("ShootRight");
-					Game::assets->CreateProjectile(Vector2D(32, 16) + (transform->position),
-						Vector2D(2, 0), 352, 1, "projectile");
+					Game::assets->CreateProjectile(muzzlePosition(), Vector2D(2, 0), 352, 1, "projectile");
 					// fix repeating animation later
 				}
 				else if (transform->facing == Vector2D(-1, 0))
 				{
 					transform->velocity.Zero();
 					sprite->Play("ShootRight");
-					Game::assets->CreateProjectile(Vector2D(-32, 16) + (transform->position),
-						Vector2D(-2, 0), 352, 1, "projectile");
+					Game::assets->CreateProjectile(muzzlePosition(), Vector2D(-2, 0), 352, 1, "projectile");
 				}
 				lastTime = currentTime;
 			}
 		}
 	}
+
+private:
+	// turns the muzzle with the player; the hierarchy moves it there at its next update
+	void aim()
+	{
+		if (muzzle) Game::hierarchy->setOffset(*muzzle, muzzleOffset(transform->facing));
+	}
+
+	Vector2D muzzlePosition()
+	{
+		if (muzzle) return muzzle->getComponent<TransformComponent>().position;
+		Vector2D offset(muzzleOffset(transform->facing));
+		return offset + transform->position;
+	}
 };
\ No newline at end of file
@@ -13,19 +13,27 @@ public:
 		sp:		The speed of the projectile.
 	*/
 	ProjectileComponent(int rng, int sp, Vector2D vel) 
+	{
+		setFlight(rng, sp, vel);
+	}
+
+	// same arguments as the constructor; takes effect at init()
+	void setFlight(int rng, int sp, Vector2D vel)
 	{
 		this->range = rng;
 		this->speed = sp;
 		this->velocity = vel;
 	}
 
-	~ProjectileComponent() {};
-
 	void init() override 
 	{
 		transform = &entity->getComponent<TransformComponent>();
 		transform->velocity = velocity;
 	}
+	void relink() override
+	{
+		transform = &entity->getComponent<TransformComponent>();
+	}
 	void update() override
 	{
 		distance += speed;
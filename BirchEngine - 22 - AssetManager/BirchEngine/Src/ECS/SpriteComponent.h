@@ -77,10 +77,6 @@ public:
 		setTexture(textureID);
 	}
 
-	~SpriteComponent()
-	{
-	}
-
 	void setTexture(std::string texID)
 	{
 		texture = Game::assets->GetTexture(texID);
@@ -95,6 +91,11 @@ public:
 		srcRect.h = transform->height;
 	}
 
+	void relink() override
+	{
+		transform = &entity->getComponent<TransformComponent>();
+	}
+
 	void update() override
 	{
 
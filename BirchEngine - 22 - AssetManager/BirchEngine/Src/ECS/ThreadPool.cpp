@@ -0,0 +1,172 @@
+#include "ThreadPool.h"
+
+namespace
+{
+	// what currentTask() is made of, for the calling thread
+	struct TaskState
+	{
+		ThreadPool::TaskKey path; // the keys of the tasks we are inside of
+		std::uint32_t runs = 0;   // run()s started at this level so far
+	};
+
+	thread_local TaskState taskState;
+	thread_local std::uint64_t taskStateVersion = 1;
+	thread_local std::size_t workerIndex = 0;
+}
+
+ThreadPool::TaskKey ThreadPool::currentTask()
+{
+	TaskKey key(taskState.path);
+	key.push_back(static_cast<std::uint64_t>(taskState.runs) << 32);
+	return key;
+}
+
+std::uint64_t ThreadPool::taskVersion()
+{
+	return taskStateVersion;
+}
+
+std::size_t ThreadPool::threadIndex()
+{
+	return workerIndex;
+}
+
+void ThreadPool::execute(const Task& task)
+{
+	TaskState outer(std::move(taskState));
+	taskState.path = *task.parent;
+	taskState.path.push_back(task.run | (task.index + 1));
+	taskState.runs = 0;
+	taskStateVersion++;
+
+	(*task.f)(task.index);
+
+	taskState = std::move(outer);
+	taskStateVersion++;
+}
+
+void ThreadPool::execute(const std::function<void()>& job)
+{
+	TaskState outer(std::move(taskState));
+	taskState = TaskState();
+	taskStateVersion++;
+
+	job();
+
+	taskState = std::move(outer);
+	taskStateVersion++;
+}
+
+ThreadPool::ThreadPool(std::size_t workerCount)
+{
+	for (std::size_t i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(&ThreadPool::work, this, i + 1);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& w : workers) w.join();
+}
+
+void ThreadPool::run(std::size_t n, const std::function<void(std::size_t)>& f)
+{
+	if (n == 0) return;
+
+	// the tasks' keys hang off ours; from here on our own code sorts after them
+	const TaskKey parent(taskState.path);
+	std::uint64_t run = static_cast<std::uint64_t>(taskState.runs++) << 32;
+	taskStateVersion++;
+
+	std::atomic<std::size_t> remaining(n);
+	if (workers.empty() || n == 1)
+	{
+		for (std::size_t i = 0; i < n; i++) execute(Task{ &f, i, &remaining, &parent, run });
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (std::size_t i = 0; i < n; i++)
+		{
+			tasks.push_back(Task{ &f, i, &remaining, &parent, run });
+		}
+	}
+	wake.notify_all();
+
+	// help out instead of sleeping; this is also what makes nested run() calls safe
+	while (remaining.load() != 0)
+	{
+		if (!runOne()) std::this_thread::yield();
+	}
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+	if (workers.empty())
+	{
+		execute(job);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	wake.notify_one();
+}
+
+bool ThreadPool::runOne()
+{
+	Task task;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (tasks.empty()) return false;
+		task = tasks.front();
+		tasks.pop_front();
+	}
+
+	execute(task);
+	task.remaining->fetch_sub(1);
+	return true;
+}
+
+void ThreadPool::work(std::size_t index)
+{
+	workerIndex = index;
+
+	for (;;)
+	{
+		Task task;
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !tasks.empty() || !jobs.empty(); });
+			if (!tasks.empty())
+			{
+				task = tasks.front();
+				tasks.pop_front();
+			}
+			else if (!jobs.empty())
+			{
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			else return; // stopping, and nothing left to do
+		}
+
+		if (job)
+		{
+			execute(job);
+			continue;
+		}
+		execute(task);
+		task.remaining->fetch_sub(1);
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+/*
+A fixed set of worker threads that the Manager hands work to.
+
+run(n, f) calls f(0) ... f(n - 1), spread over the workers AND the calling
+thread, and only returns once all n calls have finished. While it waits, the
+calling thread keeps taking tasks off the queue, so a task that calls run()
+itself (eg. a system in a parallel stage that splits its own pool into
+chunks) can never deadlock the pool.
+
+submit(job) is for work nobody waits on, like building a level in the
+background: it returns at once and job() runs later on one of the workers.
+Jobs have a queue of their own that only the workers take from, and only
+when there are no run() tasks waiting, so a long job never holds up run().
+*/
+class ThreadPool
+{
+public:
+	// a pool with no workers just runs everything on the calling thread
+	explicit ThreadPool(std::size_t workerCount);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+
+	// number of threads that take part in run(), counting the calling thread
+	std::size_t size() const { return workers.size() + 1; }
+
+	void run(std::size_t n, const std::function<void(std::size_t)>& f);
+
+	/*
+	Queues job to run on a worker and returns without waiting for it. With no
+	workers it runs job before returning. Jobs already queued still run when
+	the pool is destroyed, which waits for them.
+	*/
+	void submit(std::function<void()> job);
+
+	/*
+	Where the calling thread is in the tree of run() calls. One entry per level:
+	the number of run()s the parent had started before this one in the high 32
+	bits, and which of its tasks this is + 1 in the low 32 (0 for the parent's
+	own code between run()s). A piece of work gets the same key however the
+	tasks were spread over the threads, and sorting by key gives back the
+	order a single thread would have done them in.
+	*/
+	using TaskKey = std::vector<std::uint64_t>;
+	static TaskKey currentTask();
+	// changes whenever the calling thread's currentTask() does; cheap to compare
+	static std::uint64_t taskVersion();
+	// 0 on the main thread (or any thread that isn't a worker), 1 to size() - 1 on the workers
+	static std::size_t threadIndex();
+
+private:
+	struct Task
+	{
+		const std::function<void(std::size_t)>* f;
+		std::size_t index;
+		std::atomic<std::size_t>* remaining;
+		const TaskKey* parent; // the key of the code that called run()
+		std::uint64_t run;     // how many run()s that code had started before, in the high bits
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<Task> tasks;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	// pops one task and runs it; false if the queue was empty
+	bool runOne();
+	// runs task under its own currentTask()
+	static void execute(const Task& task);
+	// runs job outside of any run(), under a currentTask() of its own
+	static void execute(const std::function<void()>& job);
+	void work(std::size_t index);
+};
@@ -10,13 +10,9 @@ public:
 	SDL_Texture* texture;
 	SDL_Rect srcRect, destRect;
 
+	// the texture is the AssetManager's, shared by every tile cut from it
 	TileComponent() = default;
 
-	~TileComponent()
-	{
-		SDL_DestroyTexture(texture);
-	}
-
 	TileComponent(int srcX, int srcY, int posX, int posY, int tileSize, int tileScale, std::string textureID)
 	{
 		texture = Game::assets->GetTexture(textureID);
@@ -67,7 +67,13 @@ public:
 	void update() override
 	{
 		float norm = velocity.Norm(); // std::sqrt(pow(velocity.x, 2) + pow(velocity.y, 2));
-		position.x += (norm != 0) ? static_cast<int>((velocity.x * speed) / norm) : static_cast<int>(velocity.x * speed);
-		position.y += (norm != 0) ? static_cast<int>((velocity.y * speed) / norm) : static_cast<int>(velocity.y * speed);
+		int dx = (norm != 0) ? static_cast<int>((velocity.x * speed) / norm) : static_cast<int>(velocity.x * speed);
+		int dy = (norm != 0) ? static_cast<int>((velocity.y * speed) / norm) : static_cast<int>(velocity.y * speed);
+		if (dx == 0 && dy == 0) return;
+
+		position.x += dx;
+		position.y += dy;
+		// lets the collider and anything else following us know we moved
+		entity->markChanged<TransformComponent>();
 	}
 };
\ No newline at end of file
@@ -0,0 +1,185 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include "ECS.h"
+#include "Components.h"
+#include "../Vector2D.h"
+
+/*
+Parent/child links between transforms. A child's position is kept equal to
+its parent's position plus an offset, so something attached to an entity
+(the player's muzzle, a health bar, a spider riding another spider...) never
+has to copy positions by hand.
+
+The links live here rather than in TransformComponent, in one vector sorted
+so that every parent comes before its children. Once per frame update()
+walks the vector front to back and only recomputes a child whose parent's transform changed
+since last time (see Entity::markChanged<T>()). If that really moves the
+child it is marked changed in turn, which is how a move ripples down a deep
+tree in a single pass, and why a tree where nothing moved costs one tick
+compare per link.
+
+A child that moves on its own keeps that move until its parent next moves;
+move it relative to the parent with setOffset() instead. A child whose parent
+dies is left where it is, as a root. The links of dead entities are dropped
+when the Manager hands out EntityDestroyed, so a reused entity slot never
+picks up the links of the entity that had it before.
+
+Register it after ComponentSystem<TransformComponent> and before anything
+that reads positions:
+	auto& hierarchy(manager.addSystem<TransformHierarchy>(manager));
+	hierarchy.attach(muzzle, player, Vector2D(26, 16));
+*/
+class TransformHierarchy : public System
+{
+public:
+	explicit TransformHierarchy(Manager& mManager)
+	{
+		writes = getComponentSignature<TransformComponent>();
+
+		mManager.getEvents<EntityDestroyed>().subscribe([this](const std::vector<EntityDestroyed>& destroyed)
+		{
+			forget(destroyed);
+		});
+	}
+
+	/*
+	From now on mChild sits at mParent's position + mOffset. Both need a
+	TransformComponent. Attaching again moves mChild over to the new parent;
+	attaching an entity to itself or to one of its own descendants is ignored.
+	*/
+	void attach(Entity& mChild, Entity& mParent, Vector2D mOffset)
+	{
+		EntityHandle child(mChild.getHandle());
+		EntityHandle parent(mParent.getHandle());
+		for (EntityHandle h = parent;;)
+		{
+			if (h == child) return;
+			auto found(nodeOf.find(h));
+			if (found == nodeOf.end()) break;
+			h = nodes[found->second].parent;
+		}
+
+		Node node{ child, parent, mOffset, true };
+
+		auto found(nodeOf.find(child));
+		if (found != nodeOf.end())
+		{
+			nodes[found->second] = node;
+		}
+		else
+		{
+			nodeOf.emplace(child, nodes.size());
+			nodes.push_back(node);
+		}
+		sorted = false;
+	}
+
+	void setOffset(Entity& mChild, Vector2D mOffset)
+	{
+		auto found(nodeOf.find(mChild.getHandle()));
+		if (found == nodeOf.end()) return;
+
+		nodes[found->second].offset = mOffset;
+		nodes[found->second].moved = true;
+	}
+
+	std::size_t workload(Manager&) override { return nodes.size(); }
+
+	void update(Manager& manager) override
+	{
+		if (!sorted) sort();
+
+		const ComponentID transformID = getComponentTypeID<TransformComponent>();
+		std::uint32_t since = lastRun;
+		lastRun = manager.getChangeTick();
+
+		for (auto& node : nodes)
+		{
+			Entity* child = manager.getEntity(node.child);
+			Entity* parent = manager.getEntity(node.parent);
+			// died since the last refresh(); forget() drops it once EntityDestroyed is handed out
+			if (!child || !parent) continue;
+
+			if (node.moved || parent->getChangeTick(transformID) >= since)
+			{
+				node.moved = false;
+				// not position + offset: Vector2D's operator+ writes into its left side
+				const Vector2D& origin(parent->getComponent<TransformComponent>().position);
+				Vector2D world(origin.x + node.offset.x, origin.y + node.offset.y);
+
+				Vector2D& position(child->getComponent<TransformComponent>().position);
+				if (world.x != position.x || world.y != position.y)
+				{
+					position.x = world.x;
+					position.y = world.y;
+					child->markChanged<TransformComponent>();
+				}
+			}
+		}
+	}
+
+private:
+	struct Node
+	{
+		EntityHandle child;
+		EntityHandle parent;
+		Vector2D offset; // from the parent's position
+		bool moved; // attach() or setOffset() since the last update()
+	};
+
+	std::vector<Node> nodes; // parents before their children once sorted
+	std::unordered_map<EntityHandle, std::size_t> nodeOf; // a child -> its node
+	bool sorted = true;
+	std::uint32_t lastRun = 0;
+
+	void reindex()
+	{
+		nodeOf.clear();
+		for (std::size_t i = 0; i < nodes.size(); i++) nodeOf.emplace(nodes[i].child, i);
+	}
+
+	// drops every link to or from the dead, keeping the order
+	void forget(const std::vector<EntityDestroyed>& mDestroyed)
+	{
+		if (nodes.empty()) return;
+
+		std::unordered_set<EntityHandle> dead;
+		for (auto& d : mDestroyed) dead.insert(d.entity);
+
+		auto isDead = [&dead](EntityHandle h) { return dead.count(h) != 0; };
+		std::size_t before = nodes.size();
+		nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+			[&isDead](const Node& n) { return isDead(n.child) || isDead(n.parent); }), nodes.end());
+		if (nodes.size() != before) reindex();
+	}
+
+	// orders the nodes by depth, so that walking front to back visits parents first
+	void sort()
+	{
+		std::vector<std::size_t> depth(nodes.size(), 0);
+		for (std::size_t i = 0; i < nodes.size(); i++)
+		{
+			for (auto found(nodeOf.find(nodes[i].parent)); found != nodeOf.end();
+				found = nodeOf.find(nodes[found->second].parent))
+			{
+				depth[i]++;
+			}
+		}
+
+		std::vector<std::size_t> order(nodes.size());
+		for (std::size_t i = 0; i < order.size(); i++) order[i] = i;
+		std::stable_sort(order.begin(), order.end(),
+			[&depth](std::size_t a, std::size_t b) { return depth[a] < depth[b]; });
+
+		std::vector<Node> byDepth;
+		byDepth.reserve(nodes.size());
+		for (std::size_t i : order) byDepth.push_back(nodes[i]);
+		nodes.swap(byDepth);
+
+		reindex();
+		sorted = true;
+	}
+};
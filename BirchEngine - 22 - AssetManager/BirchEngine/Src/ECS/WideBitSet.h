@@ -0,0 +1,201 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+
+// SSE2 is always there on x64, and MSVC targets it on x86 by default too
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WIDE_BITSET_SSE2 1
+#endif
+
+/*
+A fixed-size bitset like std::bitset<N>, with the same interface where the
+ECS uses it, plus what std::bitset can't do cheaply: matches() tests "has all
+of these bits and none of those" in one pass over the words, without building
+temporary bitsets. With SSE2 that pass is 128 bits at a time, so a 256-bit
+signature is two loads and a few ops per side, about what a 64-bit one costs.
+
+Everything but matches() is constexpr, so signatures can still be worked out
+by the compiler (see getComponentSignature()).
+*/
+template <std::size_t N>
+class WideBitSet
+{
+public:
+	static constexpr std::size_t wordCount = (N + 63) / 64;
+
+	// what operator[] hands out, so that bits[i] = true works as it does for std::bitset
+	class reference
+	{
+	public:
+		reference(std::uint64_t& mWord, std::uint64_t mMask) : word(mWord), mask(mMask) {}
+
+		reference& operator=(bool mValue)
+		{
+			if (mValue) word |= mask;
+			else word &= ~mask;
+			return *this;
+		}
+		reference& operator=(const reference& other) { return *this = bool(other); }
+		operator bool() const { return (word & mask) != 0; }
+
+	private:
+		std::uint64_t& word;
+		std::uint64_t mask;
+	};
+
+	constexpr WideBitSet() : words{} {}
+
+	// a set with just the bits at these positions, eg. WideBitSet<256>::of({ 3, 200 })
+	static constexpr WideBitSet of(std::initializer_list<std::size_t> mBits)
+	{
+		WideBitSet b;
+		for (std::size_t i : mBits) b.words[i / 64] |= std::uint64_t(1) << (i % 64);
+		return b;
+	}
+
+	constexpr std::size_t size() const { return N; }
+
+	constexpr bool test(std::size_t i) const
+	{
+		return (words[i / 64] >> (i % 64)) & 1u;
+	}
+	constexpr bool operator[](std::size_t i) const { return test(i); }
+	reference operator[](std::size_t i)
+	{
+		return reference(words[i / 64], std::uint64_t(1) << (i % 64));
+	}
+
+	constexpr WideBitSet& set(std::size_t i, bool mValue = true)
+	{
+		if (mValue) words[i / 64] |= std::uint64_t(1) << (i % 64);
+		else words[i / 64] &= ~(std::uint64_t(1) << (i % 64));
+		return *this;
+	}
+	constexpr WideBitSet& reset(std::size_t i) { return set(i, false); }
+	constexpr WideBitSet& reset()
+	{
+		for (std::size_t w = 0; w < wordCount; w++) words[w] = 0;
+		return *this;
+	}
+
+	constexpr bool any() const
+	{
+		for (std::size_t w = 0; w < wordCount; w++)
+		{
+			if (words[w]) return true;
+		}
+		return false;
+	}
+	constexpr bool none() const { return !any(); }
+
+	std::size_t count() const
+	{
+		std::size_t n = 0;
+		for (std::size_t w = 0; w < wordCount; w++)
+		{
+			for (std::uint64_t x = words[w]; x; x &= x - 1) n++;
+		}
+		return n;
+	}
+
+	constexpr WideBitSet& operator|=(const WideBitSet& other)
+	{
+		for (std::size_t w = 0; w < wordCount; w++) words[w] |= other.words[w];
+		return *this;
+	}
+	constexpr WideBitSet& operator&=(const WideBitSet& other)
+	{
+		for (std::size_t w = 0; w < wordCount; w++) words[w] &= other.words[w];
+		return *this;
+	}
+	constexpr WideBitSet operator~() const
+	{
+		WideBitSet b;
+		for (std::size_t w = 0; w < wordCount; w++) b.words[w] = ~words[w];
+		// the bits past N stay clear, so none() and == keep working
+		if (N % 64) b.words[wordCount - 1] &= (std::uint64_t(1) << (N % 64)) - 1;
+		return b;
+	}
+
+	friend constexpr WideBitSet operator|(WideBitSet b1, const WideBitSet& b2) { return b1 |= b2; }
+	friend constexpr WideBitSet operator&(WideBitSet b1, const WideBitSet& b2) { return b1 &= b2; }
+
+	friend constexpr bool operator==(const WideBitSet& b1, const WideBitSet& b2)
+	{
+		for (std::size_t w = 0; w < wordCount; w++)
+		{
+			if (b1.words[w] != b2.words[w]) return false;
+		}
+		return true;
+	}
+	friend constexpr bool operator!=(const WideBitSet& b1, const WideBitSet& b2) { return !(b1 == b2); }
+
+	/*
+	True if every bit of mRequired is set here and no bit of mExcluded is,
+	ie. (*this & mRequired) == mRequired && (*this & mExcluded).none().
+	*/
+	bool matches(const WideBitSet& mRequired, const WideBitSet& mExcluded) const
+	{
+#ifdef WIDE_BITSET_SSE2
+		std::size_t w = 0;
+		__m128i missing = _mm_setzero_si128();
+		for (; w + 2 <= wordCount; w += 2)
+		{
+			__m128i mine = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&words[w]));
+			__m128i required = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&mRequired.words[w]));
+			__m128i excluded = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&mExcluded.words[w]));
+			// andnot(a, b) is ~a & b: the required bits we don't have
+			missing = _mm_or_si128(missing, _mm_andnot_si128(mine, required));
+			missing = _mm_or_si128(missing, _mm_and_si128(mine, excluded));
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128())) != 0xFFFF) return false;
+		// an odd word left over
+		for (; w < wordCount; w++)
+		{
+			if ((~words[w] & mRequired.words[w]) | (words[w] & mExcluded.words[w])) return false;
+		}
+		return true;
+#else
+		std::uint64_t missing = 0;
+		for (std::size_t w = 0; w < wordCount; w++)
+		{
+			missing |= (~words[w] & mRequired.words[w]) | (words[w] & mExcluded.words[w]);
+		}
+		return missing == 0;
+#endif
+	}
+
+	// true if this and other have a bit in common
+	bool intersects(const WideBitSet& other) const
+	{
+		std::uint64_t common = 0;
+		for (std::size_t w = 0; w < wordCount; w++) common |= words[w] & other.words[w];
+		return common != 0;
+	}
+
+	std::size_t hash() const
+	{
+		std::uint64_t h = 14695981039346656037ull;
+		for (std::size_t w = 0; w < wordCount; w++)
+		{
+			h = (h ^ words[w]) * 1099511628211ull;
+		}
+		return static_cast<std::size_t>(h ^ (h >> 32));
+	}
+
+private:
+	std::uint64_t words[wordCount];
+};
+
+template <std::size_t N> constexpr std::size_t WideBitSet<N>::wordCount;
+
+namespace std
+{
+	template <std::size_t N> struct hash<WideBitSet<N>>
+	{
+		std::size_t operator()(const WideBitSet<N>& b) const { return b.hash(); }
+	};
+}
@@ -2,10 +2,16 @@
 #include "TextureManager.h"
 #include "Map.h"
 #include "ECS/Components.h"
+#include "ECS/TransformHierarchy.h"
 #include "Vector2D.h"
 #include "Collision.h"
 #include "AssetManager.h"
 #include "Constants.h"
+#include "GameEvents.h"
+#include "SweepAndPrune.h"
+#include "AABBTree.h"
+#include <algorithm>
+#include <unordered_map>
 #include <cstdlib>
 #include <ctime>
 
@@ -16,14 +22,37 @@ SDL_Renderer* Game::renderer = nullptr;
 SDL_Event Game::event;
 
 AssetManager* Game::assets = new AssetManager(&manager);
+TransformHierarchy* Game::hierarchy = nullptr;
 
 bool Game::isRunning = false;
 
 auto& player(manager.addEntity());
+// the end of the player's gun, which follows him around; see KeyboardController
+auto& muzzle(manager.addEntity());
 //auto& monster(manager.addEntity());
 
 Vector2D playerPosition;
 
+// broadphase for the spiders against the bullets (the terrain has its own, see Map::GetColliders())
+SweepAndPrune movers;
+
+// every spider's collider, for asking which spiders are in some area
+AABBTree monsterTree(TILE_SIZE / 4);
+// each spider's leaf in monsterTree, by entity handle
+std::unordered_map<EntityHandle, int> monsterProxies;
+
+// who is touching whom this frame and last frame, so a collision is only reported when it begins
+std::vector<std::pair<EntityHandle, EntityHandle>> contacts;
+std::vector<std::pair<EntityHandle, EntityHandle>> lastContacts;
+
+bool contactLess(const std::pair<EntityHandle, EntityHandle>& c1, const std::pair<EntityHandle, EntityHandle>& c2)
+{
+	if (c1.first.index != c2.first.index) return c1.first.index < c2.first.index;
+	if (c1.second.index != c2.second.index) return c1.second.index < c2.second.index;
+	if (c1.first.generation != c2.first.generation) return c1.first.generation < c2.first.generation;
+	return c1.second.generation < c2.second.generation;
+}
+
 // put tiles in the game:
 
 Game::Game()
@@ -58,52 +87,145 @@ void Game::init(const char* title, int width, int height, bool fullscreen)
 	assets->AddTexture("player", "Assets/RickTangle_SpriteSheet.png");
 	assets->AddTexture("projectile", "Assets/bullet.png");
 	assets->AddTexture("monster", "Assets/monster.png");
-	// assets->AddTexture("collider", "Assets/collider.png");
+	assets->AddTexture("collider", "Assets/collider.png");
+	assets->CreatePrefabs();
 	sceneMap = new Map("terrain", 1, TILE_SIZE);
 
 	// +----------------------------+
 	// | $$$ ECS IMPLEMENTATION $$$ |
 	// +----------------------------+
 
+	// per-frame logic, one system per component type, run in this order by manager.update().
+	// Each one names the other components its update() reads and writes, which lets the
+	// Projectile, Collider and Sprite systems run side by side once the Transforms have moved.
+	// KeyboardController fires projectiles through the command buffer, so it runs alone.
+	// A collider only follows its transform, so it is only updated when the transform moved.
+	const ComponentBitSet transform(getComponentSignature<TransformComponent>());
+	manager.addSystem<ComponentSystem<KeyboardController>>(ComponentBitSet(),
+		getComponentSignature<TransformComponent, SpriteComponent>(), true);
+	manager.addSystem<ComponentSystem<TransformComponent>>();
+	hierarchy = &manager.addSystem<TransformHierarchy>(manager);
+	manager.addSystem<ComponentSystem<ProjectileComponent>>(transform);
+	manager.addSystem<ComponentSystem<ColliderComponent>>(transform, ComponentBitSet(), false, transform);
+	manager.addSystem<ComponentSystem<SpriteComponent>>(transform);
+
 	// background map:
-	sceneMap->LoadMap("Assets/map01BG.map", 11, 11, Game::groupMapBG);
+	sceneMap->LoadMap("Assets/map01BG.map", 11, 11, getComponentTypeID<MapBGTag>());
 	// 'the' map:
-	sceneMap->LoadMap("Assets/map01.map", 11, 11, Game::groupMap);
+	sceneMap->LoadMap("Assets/map01.map", 11, 11, getComponentTypeID<MapTag>());
 	// transform coordinates are in pixels. Player instantiated at (0,0) by default.
 	// Because the player sprites are 64x64 but the upper left of his body is 16 over, 16, down,
 	// we need to adjust for the offset when we place him:
 	player.addComponent<TransformComponent>(5 * TILE_SIZE - 16, 2 * TILE_SIZE - 16, Vector2D(0,1), 64, 64, 1);  // (5 * TILE_SIZE, 2 * TILE_SIZE); 
 	player.addComponent<SpriteComponent>("player", true);
 	player.addComponent<KeyboardController>();
-	player.addComponent<ColliderComponent>("player", 16, 16, TILE_SIZE, TILE_SIZE);
-	player.addGroup(groupPlayers); // reminder: player(s) is/are being drawn in Update()
+	player.addComponent<ColliderComponent>(PlayerLayer, 16, 16, TILE_SIZE, TILE_SIZE);
+	player.addTag<PlayerTag>(); // reminder: player(s) is/are being drawn in Update()
+
+	// projectiles are fired from here; KeyboardController turns it as the player turns
+	muzzle.addComponent<TransformComponent>();
+	hierarchy->attach(muzzle, player, KeyboardController::muzzleOffset(player.getComponent<TransformComponent>().facing));
+	player.getComponent<KeyboardController>().muzzle = &muzzle;
 
 	
 	playerPosition = player.getComponent<TransformComponent>().position;
 
 
 	//makes spiders of random size from 50% to 150% scale
-	for (int i = 0; i < 3; i++)	{
-		float temp = .2 + (static_cast<float>(rand())) / (static_cast<float>(RAND_MAX / (1.5 - .2)));
-		assets->CreateSpider(rand()% - 200, rand() % 100, temp);
-	}
+	assets->CreateSpiders(3);
 
 	
 
 	// fx map/overlays:
-	sceneMap->LoadMap("Assets/map01FX.map", 11, 11, groupMapFX);
+	sceneMap->LoadMap("Assets/map01FX.map", 11, 11, getComponentTypeID<MapFXTag>());
 
 	// load colliders
 	sceneMap->Map::LoadColliders("Assets/map01Colliders.map", 11, 11);
+
+	// spiders that die leave monsterTree; Game::update() hands these out right after refresh()
+	manager.getEvents<EntityDestroyed>().subscribe([](const std::vector<EntityDestroyed>& destroyed)
+	{
+		for (auto& d : destroyed)
+		{
+			auto found(monsterProxies.find(d.entity));
+			if (found == monsterProxies.end()) continue;
+			monsterTree.remove(found->second);
+			monsterProxies.erase(found);
+		}
+	});
+
+	// reactions to what update() found, run at manager.dispatchEvents()
+	manager.getEvents<CollisionBegan>().subscribe([](const std::vector<CollisionBegan>& began)
+	{
+		for (auto& c : began)
+		{
+			if (c.b == terrainHandle)
+			{
+				std::cout << "Try not to stub your precious little toes..." << std::endl;
+				continue;
+			}
+
+			Entity* other = manager.getEntity(c.b);
+			if (other && other->hasTag<MonsterTag>())
+			{
+				// We probably want the spiders to be able to overlap player
+				std::cout << "Don't get up in that spider's business!" << std::endl;
+			}
+		}
+	});
+	manager.getEvents<ProjectileHit>().subscribe([](const std::vector<ProjectileHit>& hits)
+	{
+		for (auto& hit : hits)
+		{
+			// applied at the next manager.refresh()
+			manager.getCommands().destroy(hit.projectile);
+
+			Entity* target = manager.getEntity(hit.target);
+			if (target && target->hasTag<MonsterTag>())
+			{
+				manager.getCommands().destroy(hit.target);
+				std::cout << "You shot a spider!" << std::endl;
+			}
+			else
+			{
+				std::cout << "Nice shot." << std::endl;
+			}
+		}
+	});
 }
 
-auto& mapBgTiles(manager.getGroup(Game::groupMapBG));
-auto& mapTiles(manager.getGroup(Game::groupMap));
-auto& mapFxTiles(manager.getGroup(Game::groupMapFX));
-auto& players(manager.getGroup(Game::groupPlayers));
-auto& monsters(manager.getGroup(Game::groupMonsters));
-auto& colliders(manager.getGroup(Game::groupColliders));
-auto& projectiles(manager.getGroup(Game::groupProjectiles));
+// cached by the manager, so these follow entities as they are tagged, made and destroyed
+auto& mapBgTiles(manager.getQuery(getComponentSignature<MapBGTag>()));
+auto& mapTiles(manager.getQuery(getComponentSignature<MapTag>()));
+auto& mapFxTiles(manager.getQuery(getComponentSignature<MapFXTag>()));
+auto& players(manager.getQuery(getComponentSignature<PlayerTag>()));
+auto& monsters(manager.getQuery(getComponentSignature<MonsterTag>()));
+auto& projectiles(manager.getQuery(getComponentSignature<ProjectileComponent>()));
+auto monsterColliders(manager.view<TransformComponent, ColliderComponent>(with<MonsterTag>()));
+auto& collisionsBegan(manager.getEvents<CollisionBegan>());
+auto& projectileHits(manager.getEvents<ProjectileHit>());
+auto& destroyedEntities(manager.getEvents<EntityDestroyed>());
+
+// notes that a and b overlap this frame; see reportCollisions()
+void touch(EntityHandle a, EntityHandle b)
+{
+	contacts.emplace_back(a, b);
+}
+
+// emits CollisionBegan for every pair touch()ed this frame that wasn't last frame
+void reportCollisions()
+{
+	std::sort(contacts.begin(), contacts.end(), contactLess);
+	for (auto& c : contacts)
+	{
+		if (!std::binary_search(lastContacts.begin(), lastContacts.end(), c, contactLess))
+		{
+			collisionsBegan.emit(CollisionBegan{ c.first, c.second });
+		}
+	}
+	lastContacts.swap(contacts);
+	contacts.clear();
+}
 
 void Game::handleEvents()
 {
@@ -124,102 +246,115 @@ void Game::update()
 	srand(static_cast<unsigned>(time(NULL)));
 
 	manager.refresh();
+	// now, rather than with the rest at the end, so monsterTree has no dead spiders in it this frame
+	destroyedEntities.dispatch();
+	// frees what a wave of spiders and bullets dying left empty
+	manager.compact();
 	manager.update();
 
+	// handle player collision with the map
 	bool setPlayerPos = true;
-	SDL_Rect playerCollider = player.getComponent<ColliderComponent>().collider;
-	for (auto& c : colliders)
+	ColliderComponent& playerColliderComponent = player.getComponent<ColliderComponent>();
+	SDL_Rect playerCollider = playerColliderComponent.collider;
+	if ((playerColliderComponent.mask & TerrainLayer) && sceneMap->GetColliders().overlaps(playerCollider))
 	{
-		SDL_Rect cCollider = c->getComponent<ColliderComponent>().collider;
-		if (c->getComponent<ColliderComponent>().tag == "terrainCollider" &&
-			Collision::AABB(cCollider, playerCollider))
-		{
-			setPlayerPos = false;
-			break;
-		}
+		setPlayerPos = false;
+		touch(player.getHandle(), terrainHandle);
 	}
 	if (setPlayerPos == true)
 	{
 		playerPosition = player.getComponent<TransformComponent>().position;
 	}
-	
-	// handle player collision with the map
-	for (auto& c : colliders)
+	else
 	{
-		SDL_Rect cCollider = c->getComponent<ColliderComponent>().collider;
-		if (c->getComponent<ColliderComponent>().tag == "terrainCollider" &&
-			Collision::AABB(cCollider, playerCollider))
-		{
-			// if player collides, he is reset to previous position he was in
-			player.getComponent<TransformComponent>().position = playerPosition;
-			std::cout << "Try not to stub your precious little toes..." << std::endl;
-		}
+		// if player collides, he is reset to previous position he was in
+		player.getComponent<TransformComponent>().position = playerPosition;
+		player.markChanged<TransformComponent>();
+		// and the muzzle with him, before anything fires from it
+		hierarchy->update(manager);
 	}
 
 	
-	for (auto& m : monsters)
+	const Vector2D& playerPos = player.getComponent<TransformComponent>().position;
+	for (auto m : monsterColliders)
 	{
-		float speedLo = m->getComponent<TransformComponent>().speedLo;
-		float speedHi = m->getComponent<TransformComponent>().speedHi;
+		TransformComponent& mTransform = std::get<0>(m);
+		float speedLo = mTransform.speedLo;
+		float speedHi = mTransform.speedHi;
 		
 		//jitters the speed
-		m->getComponent<TransformComponent>().speed =
+		mTransform.speed =
 			speedLo + (static_cast<float>(rand())) /
 			(static_cast<float>(RAND_MAX / (speedHi - speedLo)));
 
-		SDL_Rect mCollider = m->getComponent<ColliderComponent>().collider;
-		if (Collision::AABB(mCollider, playerCollider))
+		ColliderComponent& mCollider = std::get<1>(m);
+		EntityHandle monster(mCollider.entity->getHandle());
+		movers.update(monster, mCollider.collider, mCollider.layer, mCollider.mask);
+		// only reinserted when it has wandered out of its fat box
+		auto proxy(monsterProxies.find(monster));
+		if (proxy == monsterProxies.end())
 		{
-			// We probably want the spiders to be able to overlap player
-			std::cout << "Don't get up in that spider's business!" << std::endl;
+			monsterProxies.emplace(monster, monsterTree.insert(mCollider.collider, monster));
+		}
+		else
+		{
+			monsterTree.move(proxy->second, mCollider.collider);
 		}
 
 		//movement of enemies
 		//simple tracking algorithm
 		// hunter velocity changes based on the player's relative position
 		//if player is to the U/D/L/R, move U/D/L/R
-		if (player.getComponent<TransformComponent>().position.x <
-			m->getComponent<TransformComponent>().position.x) {
-			m->getComponent<TransformComponent>().velocity.x = -1;
+		if (playerPos.x < mTransform.position.x) {
+			mTransform.velocity.x = -1;
 		} else {
-				m->getComponent<TransformComponent>().velocity.x = 1;
+				mTransform.velocity.x = 1;
 		}
 
-		if (player.getComponent<TransformComponent>().position.y <
-			m->getComponent<TransformComponent>().position.y){
-				m->getComponent<TransformComponent>().velocity.y = - 1;
+		if (playerPos.y < mTransform.position.y){
+				mTransform.velocity.y = - 1;
 		} else {
-				m->getComponent<TransformComponent>().velocity.y = 1;
+				mTransform.velocity.y = 1;
 		}
 
 
 
 	}
 
-	// handle projectile collsions
-	for (auto& p : projectiles)
+	// the spiders touching the player
+	if (playerColliderComponent.mask & MonsterLayer)
 	{
-		for (auto& m : monsters)
+		monsterTree.query(playerCollider, [](EntityHandle mMonster, const SDL_Rect&)
 		{
-			if (Collision::AABB(m->getComponent<ColliderComponent>().collider,
-				p->getComponent<ColliderComponent>().collider))
-			{
-				p->destroy();
-				m->destroy();
-				std::cout << "You shot a spider!" << std::endl;
-			}
-		}
-		for (auto& c : colliders)
+			touch(player.getHandle(), mMonster);
+		});
+	}
+
+	// handle projectile collsions with the map here, and with monsters in the sweep below
+	const CollisionGrid& terrain = sceneMap->GetColliders();
+	for (auto p : manager.view<ProjectileComponent, ColliderComponent>())
+	{
+		ColliderComponent& pCollider = std::get<1>(p);
+		EntityHandle projectile(pCollider.entity->getHandle());
+		movers.update(projectile, pCollider.collider, pCollider.layer, pCollider.mask);
+		if ((pCollider.mask & TerrainLayer) && terrain.overlaps(pCollider.collider))
 		{
-			SDL_Rect cCollider = c->getComponent<ColliderComponent>().collider;
-			if ((c->getComponent<ColliderComponent>().tag == "terrainCollider") &&
-				Collision::AABB(cCollider, playerCollider))
-			{
-				p->destroy();
-				std::cout << "Nice shot." << std::endl;
-			}
+			projectileHits.emit(ProjectileHit{ projectile, terrainHandle });
 		}
 	}
+
+	// every overlapping pair of movers whose layers collide, lower layer first
+	movers.build();
+	movers.eachPair([](const SweepAndPrune::Proxy& a, const SweepAndPrune::Proxy& b)
+	{
+		if (a.layer == MonsterLayer && b.layer == ProjectileLayer)
+		{
+			projectileHits.emit(ProjectileHit{ b.entity, a.entity });
+		}
+	});
+
+	reportCollisions();
+	manager.dispatchEvents();
 }
 
 void Game::render()
@@ -228,42 +363,36 @@ void Game::render()
 	SDL_RenderClear(renderer);
 	
 	//first draw all the tiles:
-	for (auto& t : mapBgTiles)
+	mapBgTiles.each([](Entity& t)
 	{
-		t->draw();
-	}
-	for (auto& t : mapTiles)
+		t.draw();
+	});
+	mapTiles.each([](Entity& t)
 	{
-		t->draw();
-	}
+		t.draw();
+	});
 	// DEBUG ONLY:
 	// This line must be uncommented to see terrain colliders, specifically
-	// Those colliders have the tag "terrainCollider"
-	/*
-	for (auto& c : colliders)
+	// Those are the solid tiles of the map's collider layer
+	//sceneMap->DrawColliders();
+	projectiles.each([](Entity& p)
 	{
-		c->draw();
-	}
-	*/
-	for (auto& p : projectiles)
+		p.draw();
+	});
+	players.each([](Entity& p)
 	{
-		p->draw();
-	}
-	for (auto& p : players)
+		p.draw();
+	});
+	monsters.each([](Entity& m)
 	{
-		p->draw();
-	}
-	for (auto& m : monsters)
-	{
-		m->draw();
-	}
-	for (auto& t : mapFxTiles)
+		m.draw();
+	});
+	mapFxTiles.each([](Entity& t)
 	{
-		t->draw();
-	}
+		t.draw();
+	});
 	//end with this
 	// std::cout << "(" << players[0]->getComponent<SpriteComponent>().srcRect.x << ", " << players[0]->getComponent<SpriteComponent>().srcRect.y << ")" << std::endl;
-	// std::cout << projectiles[0]->getComponent<SpriteComponent>().animIndex << std::endl;
 	SDL_RenderPresent(renderer);
 }
 
@@ -7,6 +7,7 @@
 
 class AssetManager;
 class ColliderComponent;
+class TransformHierarchy;
 
 class Game
 {
@@ -27,16 +28,9 @@ public:
 	static SDL_Renderer* renderer;
 	static SDL_Event event;
 	static AssetManager* assets;
-	enum groupLabels : std::size_t
-	{
-		groupMapBG,
-		groupMap,
-		groupMapFX,
-		groupPlayers,
-		groupColliders,
-		groupProjectiles,
-		groupMonsters
-	};
+	// parent/child links between entities' transforms, kept up to date by the manager's update()
+	static TransformHierarchy* hierarchy;
+	// entities are sorted into map layers, players and monsters by tags: see TagList in ECS/ComponentList.h
 
 private:
 	
@@ -0,0 +1,25 @@
+#pragma once
+#include "ECS\ECS.h"
+
+/*
+What Game::update() finds out about the world each frame. The checks only
+emit these; the reactions (destroying things, printing) subscribe to them in
+Game::init() and run at manager.dispatchEvents(), at the end of the update.
+*/
+
+// stands in for the map's terrain, which is a Map::GetColliders() bitmap rather than entities
+const EntityHandle terrainHandle{ 0xFFFFFFFFu, 0xFFFFFFFFu };
+
+// two colliders that didn't overlap last frame do now
+struct CollisionBegan
+{
+	EntityHandle a;
+	EntityHandle b;
+};
+
+// a projectile ran into a monster or into the terrain
+struct ProjectileHit
+{
+	EntityHandle projectile;
+	EntityHandle target;
+};
@@ -1,8 +1,12 @@
 #include "Map.h"
 #include "Game.h"
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 #include "ECS\ECS.h"
 #include "ECS\Components.h"
+#include "TextureManager.h"
+#include "AssetManager.h"
 
 extern Manager manager; // manager is now the same variable as manager in Game.cpp
 
@@ -20,29 +24,41 @@ Map::~Map()
 	
 }
 
-// Load the map tiles:
-void Map::LoadMap(std::string path, int sizeX, int sizeY, enum Game::groupLabels groupLabel)
+/*
+Reads the whole .map file into memory at once and keeps only its digits,
+so the commas and line endings (\n or \r\n) between cells don't matter.
+*/
+static std::string ReadMapDigits(const std::string& path)
 {
-	char c;
-	std::fstream mapFile;
-	mapFile.open(path);
+	std::ifstream mapFile(path);
+	std::stringstream contents;
+	contents << mapFile.rdbuf();
 
-	int srcX, srcY;
+	std::string digits(contents.str());
+	digits.erase(std::remove_if(digits.begin(), digits.end(),
+		[](char c) { return c < '0' || c > '9'; }), digits.end());
+	return digits;
+}
 
-	// these loops parse the .map file:
-	for (int y = 0; y < sizeY; y++)
+// Load the map tiles:
+void Map::LoadMap(std::string path, int sizeX, int sizeY, ComponentID layerTag)
+{
+	// two digits per cell: the tile's row, then its column in the tileset
+	const std::string map(ReadMapDigits(path));
+	std::size_t cells = std::min(static_cast<std::size_t>(sizeX * sizeY), map.size() / 2);
+
+	// one entity per cell, all made in one go. Tiles never change, so they sleep
+	// from the start
+	ComponentBitSet tags(sleepingSignature);
+	tags[layerTag] = true;
+	manager.addEntities<TileComponent>(cells, tags, [&](Entity& tile, std::size_t i)
 	{
-		for (int x = 0; x < sizeX; x++)
-		{
-			mapFile.get(c);
-			srcY = atoi(&c)*tileSize; // atoi := character string-to-int
-			mapFile.get(c);
-			srcX = atoi(&c)*tileSize;
-			AddTile(srcX, srcY, x * (scaledSize), y * (scaledSize), groupLabel);
-			mapFile.ignore(); //skip the comma
-		}
-	}
-	mapFile.close();
+		int x = static_cast<int>(i) % sizeX;
+		int y = static_cast<int>(i) / sizeX;
+		int srcY = (map[i * 2] - '0') * tileSize;
+		int srcX = (map[i * 2 + 1] - '0') * tileSize;
+		tile.addComponent<TileComponent>(srcX, srcY, x * scaledSize, y * scaledSize, tileSize, mapScale, textureID);
+	});
 }
 
 /*
@@ -52,33 +68,24 @@ need it here to initialize "scaledSize", which should be set for every map in th
 */
 void Map::LoadColliders(std::string path, int sizeX, int sizeY)
 {
-	char c;
-	std::fstream mapFile;
-	mapFile.open(path);
-
-	int srcX, srcY; // these don't seem to be FOR anything...
-
-	for (int y = 0; y < sizeY; y++)
+	// one digit per cell: 1 where there is terrain to collide with. Terrain never
+	// moves, so it is kept as one bit per tile rather than as entities
+	const std::string map(ReadMapDigits(path));
+	colliders = CollisionGrid(sizeX, sizeY, scaledSize);
+	for (int i = 0; i < sizeX * sizeY && static_cast<std::size_t>(i) < map.size(); i++)
 	{
-		for (int x = 0; x < sizeX; x++)
-		{
-			mapFile.get(c);
-			if (c == '1')
-			{
-				auto& tileCollider(manager.addEntity());
-				tileCollider.addComponent<ColliderComponent>("terrainCollider", x * scaledSize, y * scaledSize, scaledSize, scaledSize);
-				tileCollider.addGroup(Game::groupColliders);
-			}
-			mapFile.ignore();
-		}
+		if (map[i] == '1') colliders.setSolid(i % sizeX, i / sizeX);
 	}
-	mapFile.close();
 }
 
-void Map::AddTile(int srcX, int srcY, int posX, int posY, enum Game::groupLabels groupLabel)
+void Map::DrawColliders()
 {
-	auto& tile(manager.addEntity());
-	tile.addComponent<TileComponent>(srcX, srcY, posX, posY, tileSize, mapScale, textureID);
-	tile.addGroup(groupLabel);
+	SDL_Texture* texture = Game::assets->GetTexture("collider");
+	SDL_Rect srcRect = { 0, 0, TILE_SIZE, TILE_SIZE };
+	colliders.eachSolid([&](int x, int y)
+	{
+		SDL_Rect destRect = { x * scaledSize, y * scaledSize, scaledSize, scaledSize };
+		TextureManager::Draw(texture, srcRect, destRect, SDL_FLIP_NONE);
+	});
 }
 
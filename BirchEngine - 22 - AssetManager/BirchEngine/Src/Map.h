@@ -1,6 +1,8 @@
 #pragma once
 #include <string>
 #include "Game.h"
+#include "ECS\ECS.h"
+#include "CollisionGrid.h"
 
 class Map
 {
@@ -8,9 +10,14 @@ public:
 	Map(std::string texID, int mMapScale, int mTileSize);
 	~Map();
 
-	void LoadMap(std::string path, int sizeX, int sizeY, enum Game::groupLabels groupLabel);
+	// layerTag is the tag every tile gets, eg. getComponentTypeID<MapBGTag>()
+	void LoadMap(std::string path, int sizeX, int sizeY, ComponentID layerTag);
 	void LoadColliders(std::string path, int sizeX, int sizeY);
-	void AddTile(int srcX, int srcY, int posX, int posY, enum Game::groupLabels groupLabel);
+
+	// the solid tiles LoadColliders() read, for terrain collision
+	const CollisionGrid& GetColliders() const { return colliders; }
+	// DEBUG ONLY: outlines every solid tile
+	void DrawColliders();
 
 private:
 
@@ -18,4 +25,5 @@ private:
 	int mapScale;
 	int tileSize;
 	int scaledSize;
+	CollisionGrid colliders;
 };
\ No newline at end of file
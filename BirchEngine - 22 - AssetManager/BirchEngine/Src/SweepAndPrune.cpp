@@ -0,0 +1,59 @@
+#include "SweepAndPrune.h"
+#include <algorithm>
+
+void SweepAndPrune::update(EntityHandle mEntity, const SDL_Rect& mBox, std::uint32_t mLayer, std::uint32_t mMask)
+{
+	auto found(proxyOf.find(mEntity));
+	if (found != proxyOf.end())
+	{
+		Proxy& p(proxies[found->second]);
+		p.box = mBox;
+		p.layer = mLayer;
+		p.mask = mMask;
+		p.frame = frame;
+		return;
+	}
+
+	std::uint32_t i;
+	if (!freeProxies.empty())
+	{
+		i = freeProxies.back();
+		freeProxies.pop_back();
+		proxies[i] = Proxy{ mBox, mEntity, mLayer, mMask, frame };
+	}
+	else
+	{
+		i = static_cast<std::uint32_t>(proxies.size());
+		proxies.push_back(Proxy{ mBox, mEntity, mLayer, mMask, frame });
+	}
+	proxyOf.emplace(mEntity, i);
+	// new ones go on the end; the insertion sort in build() moves them into place
+	order.push_back(i);
+}
+
+void SweepAndPrune::build()
+{
+	// whatever wasn't updated this frame is gone; removing keeps the rest in order
+	order.erase(std::remove_if(order.begin(), order.end(), [this](std::uint32_t i)
+	{
+		if (proxies[i].frame == frame) return false;
+		proxyOf.erase(proxies[i].entity);
+		freeProxies.push_back(i);
+		return true;
+	}), order.end());
+
+	// nearly sorted from last frame, so this is close to one pass
+	for (std::size_t i = 1; i < order.size(); i++)
+	{
+		std::uint32_t moving = order[i];
+		int x = proxies[moving].box.x;
+		std::size_t j = i;
+		for (; j > 0 && proxies[order[j - 1]].box.x > x; j--)
+		{
+			order[j] = order[j - 1];
+		}
+		order[j] = moving;
+	}
+
+	frame++;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <SDL.h>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "ECS\ECS.h"
+
+/*
+A broadphase for things that move a little every frame, like the spiders and
+the bullets. The boxes are kept sorted by their left edge, and the order is
+kept from one frame to the next: since nothing moves far in a frame, it is
+nearly sorted already and an insertion sort puts it right in about one pass.
+Finding the overlaps is then one sweep along x, where each box is only
+compared with the boxes starting before its right edge. When motion is
+coherent, as it is here, a frame costs about linear time in the boxes.
+
+Every frame, update() each collider with where it is now and its collision
+layer and mask (see CollisionLayer), then call build() and eachPair(). A pair
+whose layers don't collide is dropped with an AND before its boxes are
+looked at, so eg. bullets passing each other cost next to nothing. Anything
+not update()d since the last build() is taken to be gone and dropped. Boxes
+are copied in and looked up by entity handle.
+*/
+class SweepAndPrune
+{
+public:
+	struct Proxy
+	{
+		SDL_Rect box;
+		EntityHandle entity;
+		std::uint32_t layer;
+		std::uint32_t mask;
+		std::uint32_t frame; // when it was last update()d, counted in build()s
+	};
+
+	// where mEntity's collider is this frame; adds it the first time
+	void update(EntityHandle mEntity, const SDL_Rect& mBox, std::uint32_t mLayer, std::uint32_t mMask);
+	// drops what wasn't update()d and re-sorts the rest; eachPair() needs it
+	void build();
+
+	std::size_t size() const { return order.size(); }
+
+	/*
+	Calls f(const Proxy&, const Proxy&) once for every two boxes that overlap
+	(touching counts, as for Collision::AABB()) and whose layers collide. The
+	lower layer comes first, so a monster/projectile pair is always (monster,
+	projectile).
+	*/
+	template <typename F>
+	void eachPair(F f) const
+	{
+		for (std::size_t i = 0; i < order.size(); i++)
+		{
+			const Proxy& a(proxies[order[i]]);
+			int right = a.box.x + a.box.w;
+			for (std::size_t j = i + 1; j < order.size(); j++)
+			{
+				const Proxy& b(proxies[order[j]]);
+				// sorted by left edge, so nothing after this one reaches a either
+				if (b.box.x > right) break;
+				if (!(a.mask & b.layer) || !(b.mask & a.layer)) continue;
+				if (a.box.y + a.box.h >= b.box.y && b.box.y + b.box.h >= a.box.y)
+				{
+					if (a.layer <= b.layer) f(a, b);
+					else f(b, a);
+				}
+			}
+		}
+	}
+
+private:
+	std::vector<Proxy> proxies;
+	std::vector<std::uint32_t> freeProxies;
+	// indices into proxies, by left edge
+	std::vector<std::uint32_t> order;
+	std::unordered_map<EntityHandle, std::uint32_t> proxyOf;
+	std::uint32_t frame = 0;
+};
@@ -0,0 +1,111 @@
+/*
+Checks AABBTree::query() against a brute-force loop over every box, while
+boxes of mixed sizes are inserted, nudged about, moved out of their fat boxes
+and removed at random, frame after frame. Also reports the tree's height next
+to log2 of the leaf count, to show it stays balanced.
+
+Not part of the game build (it has its own main()). Build it from Src, in a
+Developer Command Prompt
+	cl /std:c++14 /EHsc /I<SDL2>\include Tests\AABBTreeTest.cpp AABBTree.cpp
+or with MinGW
+	g++ -std=c++14 -pthread -I<SDL2>/include Tests/AABBTreeTest.cpp AABBTree.cpp
+and run it: it prints what failed and returns non-zero, or prints "ok".
+*/
+#include <iostream>
+#include <random>
+#include <vector>
+#include <set>
+#include <cmath>
+#include "../AABBTree.h"
+
+static int failures = 0;
+
+static void check(bool mPassed, const char* mWhat)
+{
+	if (mPassed) return;
+	std::cout << "FAILED: " << mWhat << std::endl;
+	failures++;
+}
+
+// touching counts, like Collision::AABB()
+static bool overlaps(const SDL_Rect& mA, const SDL_Rect& mB)
+{
+	return mA.x + mA.w >= mB.x && mB.x + mB.w >= mA.x &&
+		mA.y + mA.h >= mB.y && mB.y + mB.h >= mA.y;
+}
+
+struct Box
+{
+	SDL_Rect rect;
+	int proxy;
+	bool alive;
+};
+
+int main()
+{
+	const int worldSize = 2000;
+	const int frames = 400;
+	const int queriesPerFrame = 20;
+
+	std::mt19937 random(9);
+	auto between = [&random](int lo, int hi) { return lo + static_cast<int>(random() % (hi - lo + 1)); };
+
+	AABBTree tree(4);
+	std::vector<Box> boxes(2000, Box{ SDL_Rect{ 0, 0, 0, 0 }, AABBTree::nullNode, false });
+
+	for (int frame = 0; frame < frames; frame++)
+	{
+		for (std::uint32_t i = 0; i < boxes.size(); i++)
+		{
+			Box& b(boxes[i]);
+			if (!b.alive)
+			{
+				if (between(0, 4) != 0) continue;
+				// from bullet-sized up to bigger than a scaled-up spider
+				b.rect = SDL_Rect{ between(0, worldSize), between(0, worldSize), between(6, 66), between(6, 66) };
+				b.proxy = tree.insert(b.rect, EntityHandle{ i, 0 });
+				b.alive = true;
+				continue;
+			}
+			if (between(0, 39) == 0)
+			{
+				tree.remove(b.proxy);
+				b.alive = false;
+				continue;
+			}
+			// mostly a step, now and then a jump well out of the fat box
+			int step = (between(0, 49) == 0) ? 100 : 2;
+			b.rect.x += between(-step, step);
+			b.rect.y += between(-step, step);
+			tree.move(b.proxy, b.rect);
+			check(tree.entity(b.proxy).index == i, "a proxy changed entity when its box moved");
+		}
+
+		for (int q = 0; q < queriesPerFrame; q++)
+		{
+			SDL_Rect area{ between(0, worldSize), between(0, worldSize), between(0, 200), between(0, 200) };
+
+			std::set<std::uint32_t> found;
+			tree.query(area, [&](EntityHandle mEntity, const SDL_Rect& mBox)
+			{
+				check(found.insert(mEntity.index).second, "query() reported a box twice");
+				check(overlaps(mBox, area), "query() reported a box that doesn't overlap the area");
+			});
+
+			std::set<std::uint32_t> expected;
+			for (std::uint32_t i = 0; i < boxes.size(); i++)
+			{
+				if (boxes[i].alive && overlaps(boxes[i].rect, area)) expected.insert(i);
+			}
+			check(found == expected, "query() and the brute-force loop found different boxes");
+		}
+	}
+
+	int leaves = 0;
+	for (auto& b : boxes) leaves += b.alive ? 1 : 0;
+	std::cout << leaves << " leaves, height " << tree.height() << " (log2 " << std::log2(static_cast<double>(leaves)) << ")" << std::endl;
+	check(tree.height() <= 3 * std::log2(static_cast<double>(leaves)), "the tree is far out of balance");
+
+	if (failures == 0) std::cout << "ok" << std::endl;
+	return failures;
+}
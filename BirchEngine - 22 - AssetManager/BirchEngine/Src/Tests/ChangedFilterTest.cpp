@@ -0,0 +1,62 @@
+/*
+Checks that changed<T>() filters and markChanged<T>() leave alone the entities
+that don't have a T, even before any entity has had a T.
+
+Not part of the game build (it has its own main()). Build it from Src, with
+Src itself on the include path for Constants.h, in a Developer Command Prompt
+	cl /std:c++14 /EHsc /I. /I<SDL2>\include /I<SDL2_image>\include Tests\ChangedFilterTest.cpp ECS\ECS.cpp ECS\ThreadPool.cpp Vector2D.cpp Constants.cpp
+or with MinGW
+	g++ -std=c++14 -pthread -I. -I<SDL2>/include -I<SDL2_image>/include Tests/ChangedFilterTest.cpp ECS/ECS.cpp ECS/ThreadPool.cpp Vector2D.cpp Constants.cpp
+and run it: it prints what failed and returns non-zero, or prints "ok".
+*/
+#include <iostream>
+#include "../ECS/ECS.h"
+#include "../ECS/Components.h"
+
+static int failures = 0;
+
+static void check(bool mPassed, const char* mWhat)
+{
+	if (mPassed) return;
+	std::cout << "FAILED: " << mWhat << std::endl;
+	failures++;
+}
+
+int main()
+{
+	Manager manager;
+	Entity& e(manager.addEntity());
+	e.addComponent<TransformComponent>();
+	const ComponentID colliderID = getComponentTypeID<ColliderComponent>();
+
+	// nothing has a collider, so there is no ColliderComponent column to read a tick from
+	int visited = 0;
+	manager.view<TransformComponent>().each(changed<ColliderComponent>(0), [&visited](TransformComponent&)
+	{
+		visited++;
+	});
+	check(visited == 0, "changed<ColliderComponent>() matched an entity without a collider");
+	check(e.getChangeTick(colliderID) == 0, "getChangeTick() of a missing component isn't 0");
+
+	e.markChanged<ColliderComponent>();
+	check(e.getChangeTick(colliderID) == 0, "markChanged() of a missing component stamped something");
+
+	// a component the entity does have still counts
+	visited = 0;
+	manager.view<TransformComponent>().each(changed<ColliderComponent, TransformComponent>(0), [&visited](TransformComponent&)
+	{
+		visited++;
+	});
+	check(visited == 1, "changed<ColliderComponent, TransformComponent>() missed the transform");
+
+	// the same through a system filtering on the collider
+	manager.addSystem<ComponentSystem<TransformComponent>>(ComponentBitSet(), ComponentBitSet(), false,
+		getComponentSignature<ColliderComponent>());
+	e.getComponent<TransformComponent>().velocity = Vector2D(1, 0);
+	float x = e.getComponent<TransformComponent>().position.x;
+	manager.update();
+	check(e.getComponent<TransformComponent>().position.x == x, "a system filtered on changed colliders updated a transform");
+
+	if (failures == 0) std::cout << "ok" << std::endl;
+	return failures;
+}
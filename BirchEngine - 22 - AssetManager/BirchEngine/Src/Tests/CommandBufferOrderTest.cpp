@@ -0,0 +1,115 @@
+/*
+Checks the order command buffers apply in. Entities recorded from the
+ThreadPool's workers must come out in the same slots, with the same
+components, whether there is one thread or several. Jobs handed to
+Manager::submit() must be applied in the order they were submitted, even
+when a later one finishes first.
+
+Not part of the game build (it has its own main()). Build it from Src, with
+Src itself on the include path for Constants.h, in a Developer Command Prompt
+	cl /std:c++14 /EHsc /I. /I<SDL2>\include /I<SDL2_image>\include Tests\CommandBufferOrderTest.cpp ECS\ECS.cpp ECS\ThreadPool.cpp Vector2D.cpp Constants.cpp
+or with MinGW
+	g++ -std=c++14 -pthread -I. -I<SDL2>/include -I<SDL2_image>/include Tests/CommandBufferOrderTest.cpp ECS/ECS.cpp ECS/ThreadPool.cpp Vector2D.cpp Constants.cpp
+and run it: it prints what failed and returns non-zero, or prints "ok".
+*/
+#include <iostream>
+#include <vector>
+#include <utility>
+#include <thread>
+#include <chrono>
+#include "../ECS/ECS.h"
+#include "../ECS/Components.h"
+
+static int failures = 0;
+
+static void check(bool mPassed, const char* mWhat)
+{
+	if (mPassed) return;
+	std::cout << "FAILED: " << mWhat << std::endl;
+	failures++;
+}
+
+// every entity's slot and x position, in slot order (all of them have a transform)
+static std::vector<std::pair<std::uint32_t, float>> slotsOf(Manager& mManager)
+{
+	std::vector<std::pair<std::uint32_t, float>> slots;
+	for (std::uint32_t i = 0;; i++)
+	{
+		if (!mManager.isValid(EntityHandle{ i, 0u })) break;
+		slots.emplace_back(i, mManager.getEntity(EntityHandle{ i, 0u })->getComponent<TransformComponent>().position.x);
+	}
+	return slots;
+}
+
+static const std::size_t taskCount = 64;
+
+static std::size_t entitiesOf(std::size_t mTask)
+{
+	return 1 + (mTask % 7) * 20;
+}
+
+// builds the same entities from the main thread and from tasks spread over mThreads threads
+static std::vector<std::pair<std::uint32_t, float>> buildWith(std::size_t mThreads)
+{
+	Manager manager;
+	manager.setThreadCount(mThreads);
+
+	CommandBuffer& mainCommands(manager.getCommands());
+	mainCommands.addComponent<TransformComponent>(mainCommands.createEntity(), -1.0f, 0.0f);
+
+	// uneven tasks, so the threads finish them in a different order every time
+	manager.getThreadPool().run(taskCount, [&manager](std::size_t mTask)
+	{
+		CommandBuffer& commands(manager.getCommands());
+		for (std::size_t k = 0; k < entitiesOf(mTask); k++)
+		{
+			auto e(commands.createEntity());
+			commands.addComponent<TransformComponent>(e, static_cast<float>(mTask * 1000 + k), 0.0f);
+			if (k % 3 == 0) commands.addTag<MonsterTag>(e);
+		}
+	});
+
+	mainCommands.addComponent<TransformComponent>(mainCommands.createEntity(), -2.0f, 0.0f);
+	manager.refresh();
+	return slotsOf(manager);
+}
+
+int main()
+{
+	std::size_t recorded = 2;
+	for (std::size_t t = 0; t < taskCount; t++) recorded += entitiesOf(t);
+
+	auto one(buildWith(1));
+	check(one.size() == recorded, "not every recorded entity was created");
+	check(!one.empty() && one.front().second == -1.0f, "the main thread's first entity isn't in the first slot");
+	check(buildWith(2) == one, "2 threads put the entities in other slots than 1 thread");
+	check(buildWith(4) == one, "4 threads put the entities in other slots than 1 thread");
+
+	for (std::size_t threads : { 1u, 4u })
+	{
+		Manager manager;
+		manager.setThreadCount(threads);
+		for (int i = 0; i < 20; i++)
+		{
+			manager.submit([i](CommandBuffer& mCommands)
+			{
+				// every third job takes longer, so later jobs finish before it
+				if (i % 3 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+				mCommands.addComponent<TransformComponent>(mCommands.createEntity(), static_cast<float>(i), 0.0f);
+			});
+		}
+		while (manager.pendingJobs() != 0)
+		{
+			manager.refresh();
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+
+		auto slots(slotsOf(manager));
+		bool inOrder = slots.size() == 20;
+		for (auto& s : slots) inOrder = inOrder && s.second == static_cast<float>(s.first);
+		check(inOrder, "jobs weren't applied in the order they were submitted");
+	}
+
+	if (failures == 0) std::cout << "ok" << std::endl;
+	return failures;
+}